@@ -0,0 +1,226 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Bump allocator: allocations are carved out of big blocks and never freed one by one, the whole arena is
+// dropped at once with reset() (keeps one block) or release(). Sized up front from what is known
+// (Assimp's vertex and face counts for an import) it is a single heap allocation for the whole job.
+class Arena
+{
+public:
+    Arena() {}
+    explicit Arena(size_t bytes) { reserve(bytes); }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    Arena(Arena&& other) noexcept { swap(other); }
+    Arena& operator=(Arena&& other) noexcept { swap(other); return *this; }
+
+    // makes sure the next 'bytes' fit without another block
+    void reserve(size_t bytes)
+    {
+        if (blocks.empty() || capacity - used < bytes) addBlock(bytes);
+    }
+
+    void* allocate(size_t bytes, size_t alignment = alignof(std::max_align_t))
+    {
+        size_t offset = (used + alignment - 1) & ~(alignment - 1);
+        if (blocks.empty() || offset + bytes > capacity) {
+            addBlock(std::max(bytes + alignment, capacity * 2));
+            offset = 0;
+        }
+        used = offset + bytes;
+        allocations++;
+        bytesAllocated += bytes;
+        return blocks.back().get() + offset;
+    }
+
+    // uninitialised storage for 'count' T, T has to be trivially destructible (nothing is destroyed)
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        return static_cast<T*>(allocate(count * sizeof(T), alignof(T)));
+    }
+
+    // forgets everything allocated, the last (biggest) block is kept for the next use
+    void reset()
+    {
+        if (blocks.size() > 1) {
+            std::unique_ptr<char[]> last = std::move(blocks.back());
+            blocks.clear();
+            blocks.push_back(std::move(last));
+            reserved = capacity;
+        }
+        used = 0;
+        allocations = 0;
+        bytesAllocated = 0;
+    }
+
+    // frees every block
+    void release()
+    {
+        blocks.clear();
+        capacity = 0;
+        reserved = 0;
+        used = 0;
+        allocations = 0;
+        bytesAllocated = 0;
+    }
+
+    size_t allocationCount() const { return allocations; }
+    size_t bytesUsed() const { return bytesAllocated; }
+    size_t blockCount() const { return blocks.size(); }
+    size_t bytesReserved() const { return reserved; }
+
+private:
+    std::vector<std::unique_ptr<char[]>> blocks;
+    size_t capacity = 0;        // of the last block, older blocks are full
+    size_t used = 0;            // in the last block
+    size_t allocations = 0;
+    size_t bytesAllocated = 0;
+    size_t reserved = 0;        // all blocks together
+
+    void addBlock(size_t bytes)
+    {
+        bytes = std::max(bytes, (size_t)4096);
+        blocks.push_back(std::unique_ptr<char[]>(new char[bytes]));
+        capacity = bytes;
+        used = 0;
+        reserved += bytes;
+    }
+
+    void swap(Arena& other)
+    {
+        blocks.swap(other.blocks);
+        std::swap(capacity, other.capacity);
+        std::swap(used, other.used);
+        std::swap(allocations, other.allocations);
+        std::swap(bytesAllocated, other.bytesAllocated);
+        std::swap(reserved, other.reserved);
+    }
+};
+
+// Transient per frame data. Two arenas take turns: beginFrame() resets the one used the frame before last, so
+// what a frame wrote stays valid through the next one. Once both arenas hold a block big enough for a frame,
+// frames no longer touch the heap; 'growths' counts the times they still had to.
+class FrameAllocator
+{
+public:
+    explicit FrameAllocator(size_t bytesPerFrame = 64 * 1024)
+    {
+        arenas[0].reserve(bytesPerFrame);
+        arenas[1].reserve(bytesPerFrame);
+    }
+
+    void beginFrame()
+    {
+        current ^= 1;
+        arenas[current].reset();
+    }
+
+    template <typename T>
+    T* allocate(size_t count)
+    {
+        Arena& arena = arenas[current];
+        size_t blocks = arena.blockCount();
+        T* p = arena.allocate<T>(count);
+        if (arena.blockCount() != blocks) growths++;
+        peakBytes = std::max(peakBytes, arena.bytesUsed());
+        return p;
+    }
+
+    size_t frameAllocations() const { return arenas[current].allocationCount(); }
+    size_t frameBytes() const { return arenas[current].bytesUsed(); }
+    size_t peak() const { return peakBytes; }
+    unsigned long long heapGrowths() const { return growths; }
+
+private:
+    Arena arenas[2];
+    unsigned int current = 0;
+    size_t peakBytes = 0;
+    unsigned long long growths = 0;
+};
+
+// General heap allocations (operator new) of the process, counted only in programs that define
+// COUNT_ALLOCATIONS before including this header in exactly one translation unit, 0 otherwise.
+inline std::atomic<unsigned long long>& heapAllocationCounter()
+{
+    static std::atomic<unsigned long long> counter(0);
+    return counter;
+}
+
+inline unsigned long long heapAllocations() { return heapAllocationCounter().load(std::memory_order_relaxed); }
+
+#ifdef COUNT_ALLOCATIONS
+inline bool heapAllocationsCounted() { return true; }
+#else
+inline bool heapAllocationsCounted() { return false; }
+#endif
+
+// Proves the steady state allocation free: every frame reports its heap allocations and whether it was quiet
+// (past the warm-up, no input handled, no asset loading). Quiet frames have to allocate nothing.
+class AllocationCheck
+{
+public:
+    unsigned int warmupFrames = 120;
+
+    void frame(unsigned long long allocations, bool quiet)
+    {
+        frames++;
+        if (frames <= warmupFrames || !quiet) return;
+        quietFrames++;
+        if (allocations == 0) return;
+        allocatingFrames++;
+        quietAllocations += allocations;
+        if (allocations > worstAllocations) {
+            worstAllocations = allocations;
+            worstFrame = frames - 1;
+        }
+    }
+
+    // the run didn't cover what it was meant to (e.g. a replay cut short), fails the check
+    void incomplete(const char* why) { incompleteReason = why; }
+
+    bool passed() const { return quietFrames > 0 && allocatingFrames == 0 && !incompleteReason; }
+
+    void report(std::ostream& out) const
+    {
+        out << "Allocation check: " << (passed() ? "PASSED" : "FAILED") << ", " << quietFrames << " quiet frames of " << frames;
+        if (allocatingFrames)
+            out << ", " << allocatingFrames << " allocated (" << quietAllocations << " allocations, worst frame " << worstFrame
+                << " with " << worstAllocations << ")";
+        else if (quietFrames == 0)
+            out << ", nothing to check (run longer than " << warmupFrames << " frames)";
+        if (incompleteReason) out << ", " << incompleteReason;
+        out << "\n";
+    }
+
+private:
+    unsigned int frames = 0, quietFrames = 0, allocatingFrames = 0, worstFrame = 0;
+    unsigned long long quietAllocations = 0, worstAllocations = 0;
+    const char* incompleteReason = nullptr;
+};
+
+#ifdef COUNT_ALLOCATIONS
+void* operator new(size_t bytes)
+{
+    heapAllocationCounter().fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(bytes ? bytes : 1)) return p;
+    throw std::bad_alloc();
+}
+void* operator new[](size_t bytes) { return operator new(bytes); }
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+#endif
+
+#endif
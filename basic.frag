@@ -1,12 +1,32 @@
 #version 330 core
-out vec4 FragColor;
-
-
+layout (location = 0) out vec4 FragColor;   // albedo in the G-buffer pass
+
+#ifdef GBUFFER
+// deferred.hpp geometry pass: no lighting, only the surface
+layout (location = 1) out vec4 gNormal;
+#endif
+
+#ifdef DEFERRED_LIGHTING
+// deferred.hpp full screen pass: the surface comes from the G-buffer instead of the vertex shader
+uniform sampler2D uGAlbedo;
+uniform sampler2D uGNormal;
+uniform sampler2D uGDepth;
+uniform mat4 uInvViewProj;
+
+vec3 chNormal;
+vec3 chFragPos;
+#else
 in vec3 chNormal;
 in vec3 chFragPos;
 in vec2 chUV;
+#endif
 
+#ifdef INDIRECT
+flat in vec3 chTint;    // per draw tint from indirect.vert
+flat in uint chLayer;   // diffuse layer in uDiffArray
+#else
 uniform vec3 uTint;  
+#endif
 
 uniform vec3 uLightPos1;
 uniform vec3 uLightColor1;
@@ -16,9 +36,76 @@ uniform vec3 uLightColor2;
 
 
 uniform vec3 uViewPos;
+#ifdef INDIRECT
+uniform sampler2DArray uDiffArray;
+#else
 uniform sampler2D uDiffMap1;
+#endif
+
+#ifdef SHADOWS
+// sun shadows from shadows.hpp: cached static layer + per frame dynamic atlas, one tile per moving caster
+uniform sampler2DShadow uShadowStatic;
+uniform sampler2DShadow uShadowDynamic;
+uniform mat4 uShadowStaticSpace;
+uniform mat4 uShadowDynamicSpace;     // light view x/y, depth over the whole scene
+uniform int uShadowTileCount;
+uniform vec4 uShadowTiles[16];        // ShadowMaps::maxDynamicTiles, light x/y -> atlas uv: xy offset, z scale
+uniform vec4 uShadowTileRects[16];    // atlas uv each tile may be sampled in, min xy, max zw
+
+// 2x2 taps on top of the bilinear comparison
+float shadowTaps(sampler2DShadow map, vec2 uv, float depth)
+{
+    vec2 texel = 1.0 / vec2(textureSize(map, 0));
+    float lit = 0.0;
+    for (int x = 0; x < 2; x++)
+        for (int y = 0; y < 2; y++)
+            lit += textureLod(map, vec3(uv + (vec2(x, y) - 0.5) * texel, depth), 0.0);
+    return lit * 0.25;
+}
+
+float staticShadow()
+{
+    vec4 p = uShadowStaticSpace * vec4(chFragPos, 1.0);
+    vec3 coords = p.xyz / p.w * 0.5 + 0.5;
+    if (coords.z > 1.0) return 1.0;
+    return shadowTaps(uShadowStatic, coords.xy, coords.z);
+}
+
+// tiles can overlap in light space (trains passing each other), the darkest one wins
+float dynamicShadow()
+{
+    vec4 p = uShadowDynamicSpace * vec4(chFragPos, 1.0);
+    float depth = p.z * 0.5 + 0.5;
+    if (depth > 1.0) return 1.0;
+
+    float lit = 1.0;
+    for (int i = 0; i < uShadowTileCount; i++) {
+        vec2 uv = p.xy * uShadowTiles[i].z + uShadowTiles[i].xy;
+        vec4 rect = uShadowTileRects[i];
+        if (any(lessThan(uv, rect.xy)) || any(greaterThan(uv, rect.zw))) continue;
+        lit = min(lit, shadowTaps(uShadowDynamic, uv, depth));
+    }
+    return lit;
+}
 
-vec3 calcLight(vec3 lightPos, vec3 lightColor, vec3 normal)
+float calcShadow()
+{
+    return min(staticShadow(), dynamicShadow());
+}
+#endif
+
+#ifdef CLUSTERED
+// park lights, filled by clustered.hpp every frame
+uniform samplerBuffer uClusterLights;     // 2 texels per light: position, radius / color
+uniform usamplerBuffer uClusterGrid;      // per cluster: first index, count
+uniform usamplerBuffer uClusterIndices;
+uniform vec2 uClusterTileSize;            // pixels per tile
+uniform vec2 uClusterSlice;               // slice = log(depth) * x + y
+uniform mat4 uV;
+#endif
+
+// 'shadow' scales diffuse and specular, 1 = fully lit
+vec3 calcLight(vec3 lightPos, vec3 lightColor, vec3 normal, float shadow)
 {
     // ambient
     float ambientStrength = 0.1;
@@ -36,20 +123,95 @@ vec3 calcLight(vec3 lightPos, vec3 lightColor, vec3 normal)
     float spec = pow(max(dot(viewDir, reflectDir), 0.0), 32);
     vec3 specular = specularStrength * spec * lightColor;
 
-    return ambient + diffuse + specular;
+    return ambient + shadow * (diffuse + specular);
 }
 
+#ifdef CLUSTERED
+// only the lights assigned to this fragment's cluster
+vec3 calcClusterLights(vec3 normal)
+{
+    float depth = -(uV * vec4(chFragPos, 1.0)).z;
+    int slice = clamp(int(log(max(depth, 1e-4)) * uClusterSlice.x + uClusterSlice.y), 0, CLUSTER_SLICES - 1);
+    ivec2 tile = clamp(ivec2(gl_FragCoord.xy / uClusterTileSize), ivec2(0), ivec2(CLUSTER_TILES_X - 1, CLUSTER_TILES_Y - 1));
+    int cluster = tile.x + tile.y * CLUSTER_TILES_X + slice * CLUSTER_TILES_X * CLUSTER_TILES_Y;
+    uvec2 range = texelFetch(uClusterGrid, cluster).xy;
+
+    vec3 viewDir = normalize(uViewPos - chFragPos);
+    vec3 result = vec3(0.0);
+    for (uint i = 0u; i < range.y; i++) {
+        int light = int(texelFetch(uClusterIndices, int(range.x + i)).r);
+        vec4 posRadius = texelFetch(uClusterLights, light * 2);
+        vec3 color = texelFetch(uClusterLights, light * 2 + 1).rgb;
+
+        vec3 toLight = posRadius.xyz - chFragPos;
+        float dist = length(toLight);
+        if (dist >= posRadius.w) continue;
+        vec3 lightDir = toLight / dist;
+
+        // inverse square, windowed to reach zero at the radius
+        float window = clamp(1.0 - pow(dist / posRadius.w, 4.0), 0.0, 1.0);
+        float attenuation = window * window / (1.0 + dist * dist);
+
+        float diff = max(dot(normal, lightDir), 0.0);
+        float spec = pow(max(dot(viewDir, reflect(-lightDir, normal)), 0.0), 32);
+        result += (diff + 0.5 * spec) * attenuation * color;
+    }
+    return result;
+}
+#endif
+
 void main()
 {
+#ifdef OVERDRAW
+    // every shaded fragment adds one step, additive blending turns the count into a heat map
+    FragColor = vec4(0.1, 0.04, 0.015, 1.0);
+    return;
+#endif
+
+#ifdef DEFERRED_LIGHTING
+    ivec2 pixel = ivec2(gl_FragCoord.xy);
+    float depth = texelFetch(uGDepth, pixel, 0).r;
+    if (depth == 1.0) discard;      // nothing drawn here, keep the clear color
+
+    vec2 ndc = (vec2(pixel) + 0.5) / vec2(textureSize(uGDepth, 0)) * 2.0 - 1.0;
+    vec4 world = uInvViewProj * vec4(ndc, depth * 2.0 - 1.0, 1.0);
+    chFragPos = world.xyz / world.w;
+    chNormal = texelFetch(uGNormal, pixel, 0).xyz;
+    vec4 albedo = texelFetch(uGAlbedo, pixel, 0);   // texture * tint
+#else
+#ifdef INDIRECT
+    vec4 texColor = texture(uDiffArray, vec3(chUV, float(chLayer)));
+#else
+    vec4 texColor = texture(uDiffMap1, chUV);
+#endif
+#ifdef INDIRECT
+    vec3 tint = chTint;
+#else
+    vec3 tint = uTint;
+#endif
+    vec4 albedo = vec4(texColor.rgb * tint, texColor.a);
+#endif
+
+#ifdef GBUFFER
+    FragColor = albedo;
+    gNormal = vec4(normalize(chNormal), 0.0);
+#else
     vec3 norm = normalize(chNormal);
 
-    vec3 light1 = calcLight(uLightPos1, uLightColor1, norm);
-    vec3 light2 = calcLight(uLightPos2, uLightColor2, norm);
+#ifdef SHADOWS
+    float shadow = calcShadow();
+#else
+    float shadow = 1.0;
+#endif
+    vec3 light1 = calcLight(uLightPos1, uLightColor1, norm, shadow);
+    vec3 light2 = calcLight(uLightPos2, uLightColor2, norm, 1.0);
 
     vec3 result = light1 + light2;
+#ifdef CLUSTERED
+    result += calcClusterLights(norm);
+#endif
 
-    vec4 texColor = texture(uDiffMap1, chUV);
-    vec3 finalColor = texColor.rgb * result * uTint;
-    FragColor = vec4(finalColor, texColor.a);
+    FragColor = vec4(albedo.rgb * result, albedo.a);
+#endif
 
 }
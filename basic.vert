@@ -1,22 +1,39 @@
 #version 330 core
 layout (location = 0) in vec3 inPos;
+#ifndef DEPTH_ONLY
 layout (location = 1) in vec3 inNormal;
 layout (location = 2) in vec2 inUV;
 
 out vec3 chFragPos;
 out vec3 chNormal;
 out vec2 chUV;
+#endif
 
+#ifdef INSTANCED
+layout (location = 3) in mat4 inModel;    // per instance model matrix (trackgen.hpp), instead of uM
+#else
 uniform mat4 uM;
+#endif
 uniform mat4 uV;
 uniform mat4 uP;
 
+// the depth pre-pass (DEPTH_ONLY) and the colour pass must produce bit identical depth for GL_EQUAL
+invariant gl_Position;
+
 void main()
 {
+#ifdef INSTANCED
+    mat4 model = inModel;
+#else
+    mat4 model = uM;
+#endif
+    vec3 fragPos = vec3(model * vec4(inPos, 1.0));
+#ifndef DEPTH_ONLY
     chUV = inUV;
-    chFragPos = vec3(uM * vec4(inPos, 1.0));
-    chNormal = mat3(transpose(inverse(uM))) * inNormal;  
+    chFragPos = fragPos;
+    chNormal = mat3(transpose(inverse(model))) * inNormal;  
+#endif
     
-    gl_Position = uP * uV * vec4(chFragPos, 1.0);
+    gl_Position = uP * uV * vec4(fragPos, 1.0);
 }
 
@@ -0,0 +1,195 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Minimal benchmark runner: every benchmark is timed as a number of samples, each sample runs the
+// body enough times to last at least minSampleTime (cheap bodies are batched), and the per call
+// times are summarised as mean / median / stddev / min / max / p95 in nanoseconds.
+//
+//   BenchRunner bench(argc, argv);
+//   bench.run("getCarPosition", [&] { doNotOptimize(getCarPosition(points, t)); });
+//   bench.writeJson();
+//
+// Options: --out FILE (default bench_results.json), --filter SUBSTRING, --samples N, --min-time MS
+
+// keeps the compiler from throwing away a result that is otherwise unused
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "g"(&value) : "memory");
+#else
+    static volatile const void* sink;
+    sink = &value;
+#endif
+}
+
+struct BenchResult {
+    std::string name;
+    unsigned int samples = 0;
+    unsigned long long callsPerSample = 0;
+    double mean = 0.0, median = 0.0, stddev = 0.0, min = 0.0, max = 0.0, p95 = 0.0;  // ns per call
+};
+
+class BenchRunner
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string outputPath = "bench_results.json";
+    std::string filter;
+    unsigned int samples = 30;
+    double minSampleTime = 0.005;   // seconds
+
+    BenchRunner(int argc, char** argv)
+    {
+        for (int i = 1; i < argc; i++) {
+            std::string arg = argv[i];
+            if (arg == "--out" && i + 1 < argc) outputPath = argv[++i];
+            else if (arg == "--filter" && i + 1 < argc) filter = argv[++i];
+            else if (arg == "--samples" && i + 1 < argc) samples = (unsigned int)std::max(1, atoi(argv[++i]));
+            else if (arg == "--min-time" && i + 1 < argc) minSampleTime = atof(argv[++i]) / 1000.0;
+            else if (arg == "--help") {
+                std::cout << "usage: " << argv[0] << " [--out FILE] [--filter SUBSTRING] [--samples N] [--min-time MS]\n";
+                exit(0);
+            }
+            else std::cout << "WARNING::BENCH:: unknown option " << arg << "\n";
+        }
+    }
+
+    bool selected(const std::string& name) const
+    {
+        return filter.empty() || name.find(filter) != std::string::npos;
+    }
+
+    // 'sampleCount' overrides --samples for slow bodies (model import), 0 keeps the default
+    template <typename F>
+    void run(const std::string& name, F body, unsigned int sampleCount = 0)
+    {
+        if (!selected(name)) return;
+        unsigned int n = sampleCount ? std::min(sampleCount, samples) : samples;
+
+        // warm up and find how many calls make one sample long enough to time
+        unsigned long long calls = 1;
+        for (;;) {
+            double t = time(body, calls);
+            if (t >= minSampleTime || calls >= (1ull << 30)) break;
+            calls *= t > 0.0 ? std::max(2.0, std::min(100.0, minSampleTime / t * 1.2)) : 100.0;
+        }
+
+        std::vector<double> perCall(n);
+        for (unsigned int i = 0; i < n; i++)
+            perCall[i] = time(body, calls) * 1e9 / (double)calls;
+
+        BenchResult r = summarize(name, perCall, calls);
+        results.push_back(r);
+        print(r);
+    }
+
+    bool writeJson() const
+    {
+        std::ofstream out(outputPath);
+        if (!out.is_open()) {
+            std::cout << "ERROR::BENCH:: can't write " << outputPath << std::endl;
+            return false;
+        }
+
+        char date[32];
+        std::time_t now = std::time(nullptr);
+        std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S", std::localtime(&now));
+
+        out << std::setprecision(10);
+        out << "{\n  \"context\": {\"date\": \"" << date << "\", \"compiler\": \"" << compiler() << "\""
+            << ", \"build_type\": \"" << buildType() << "\", \"unit\": \"ns\"},\n  \"benchmarks\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            const BenchResult& r = results[i];
+            out << "    {\"name\": \"" << r.name << "\", \"samples\": " << r.samples << ", \"calls_per_sample\": " << r.callsPerSample
+                << ", \"mean\": " << r.mean << ", \"median\": " << r.median << ", \"stddev\": " << r.stddev
+                << ", \"min\": " << r.min << ", \"max\": " << r.max << ", \"p95\": " << r.p95 << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "  ]\n}\n";
+        std::cout << "Benchmark results written to " << outputPath << std::endl;
+        return true;
+    }
+
+private:
+    std::vector<BenchResult> results;
+
+    template <typename F>
+    static double time(F& body, unsigned long long calls)
+    {
+        Clock::time_point start = Clock::now();
+        for (unsigned long long i = 0; i < calls; i++)
+            body();
+        return std::chrono::duration<double>(Clock::now() - start).count();
+    }
+
+    static BenchResult summarize(const std::string& name, std::vector<double>& values, unsigned long long calls)
+    {
+        BenchResult r;
+        r.name = name;
+        r.samples = (unsigned int)values.size();
+        r.callsPerSample = calls;
+
+        std::sort(values.begin(), values.end());
+        size_t n = values.size();
+        double sum = 0.0;
+        for (double v : values) sum += v;
+        r.mean = sum / n;
+
+        double var = 0.0;
+        for (double v : values) var += (v - r.mean) * (v - r.mean);
+        r.stddev = n > 1 ? std::sqrt(var / (n - 1)) : 0.0;
+
+        r.min = values.front();
+        r.max = values.back();
+        r.median = n % 2 ? values[n / 2] : 0.5 * (values[n / 2 - 1] + values[n / 2]);
+        r.p95 = values[(size_t)(0.95 * (n - 1) + 0.5)];
+        return r;
+    }
+
+    static void print(const BenchResult& r)
+    {
+        std::cout << std::left << std::setw(44) << r.name << std::right << std::fixed << std::setprecision(1)
+                  << " median " << std::setw(12) << r.median << " ns"
+                  << "  mean " << std::setw(12) << r.mean
+                  << "  p95 " << std::setw(12) << r.p95
+                  << "  sd " << std::setw(10) << r.stddev << "\n";
+        std::cout.unsetf(std::ios::fixed);
+    }
+
+    static const char* compiler()
+    {
+#if defined(__clang__)
+        return "clang " __clang_version__;
+#elif defined(__GNUC__)
+        return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+        return "msvc";
+#else
+        return "unknown";
+#endif
+    }
+
+    static const char* buildType()
+    {
+#ifdef NDEBUG
+        return "release";
+#else
+        return "debug";
+#endif
+    }
+};
+
+#endif
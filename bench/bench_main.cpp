@@ -0,0 +1,188 @@
+// Microbenchmarks for the load path and the per frame hot paths.
+// Run from the repository root so res/ is found:  ./_build/rc_bench --out bench_results.json
+
+#include "bench.hpp"
+
+// operator new is counted (arena.hpp), the import benchmarks report heap allocations per load
+#define COUNT_ALLOCATIONS
+
+#include "../track.hpp"
+#include "../model.hpp"
+#include "../guestflow.hpp"
+#include "../comfort.hpp"
+
+#include <glm/gtc/constants.hpp>
+
+#include <cstdio>
+#include <random>
+
+// synthetic track of 'parts' rail parts laid out like res/tracks.obj: trackVerticesPerPart vertices
+// around every key point, parts stored in random order so generateKeyPoints has to sort them
+static std::vector<glm::vec3> syntheticTrack(int parts)
+{
+    std::mt19937 rng(1234u + parts);
+    std::uniform_real_distribution<float> jitter(-0.3f, 0.3f);
+
+    std::vector<int> order(parts);
+    for (int i = 0; i < parts; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+
+    float radius = 0.5f * parts / glm::two_pi<float>();   // ~0.5 units between parts
+    std::vector<glm::vec3> vertices;
+    vertices.reserve((size_t)parts * trackVerticesPerPart);
+    for (int k = 0; k < parts; k++) {
+        float a = glm::two_pi<float>() * order[k] / parts;
+        glm::vec3 center(radius * cos(a), 4.0f * sin(3.0f * a) + 5.0f, radius * sin(a));
+        for (int v = 0; v < trackVerticesPerPart; v++)
+            vertices.push_back(center + glm::vec3(jitter(rng), jitter(rng), jitter(rng)));
+    }
+    return vertices;
+}
+
+static bool writeObj(const std::string& path, const std::vector<glm::vec3>& vertices)
+{
+    std::ofstream out(path);
+    if (!out.is_open()) return false;
+    for (const glm::vec3& v : vertices)
+        out << "v " << v.x << " " << v.y << " " << v.z << "\n";
+    return true;
+}
+
+static bool fileExists(const std::string& path)
+{
+    std::ifstream file(path);
+    return file.good();
+}
+
+int main(int argc, char** argv)
+{
+    BenchRunner bench(argc, argv);
+    const int trackSizes[] = { 64, 256, 1024 };
+
+    // --- track loading ---
+    for (int parts : trackSizes) {
+        std::string path = "bench_track_" + std::to_string(parts) + ".obj";
+        std::string name = "loadTrackVertices/" + std::to_string(parts);
+        if (!bench.selected(name)) continue;
+        if (!writeObj(path, syntheticTrack(parts))) {
+            std::cout << "ERROR::BENCH:: can't write " << path << "\n";
+            continue;
+        }
+        std::vector<glm::vec3> raw;
+        bench.run(name, [&] { loadTrackVertices(path, raw); doNotOptimize(raw); }, 10);
+        std::remove(path.c_str());
+    }
+    if (fileExists("res/tracks.obj")) {
+        std::vector<glm::vec3> raw;
+        bench.run("loadTrackVertices/res", [&] { loadTrackVertices("res/tracks.obj", raw); doNotOptimize(raw); }, 10);
+    }
+
+    for (int parts : trackSizes) {
+        std::vector<glm::vec3> raw = syntheticTrack(parts), keyPoints, sortedPoints;
+        bench.run("generateKeyPoints/" + std::to_string(parts), [&] {
+            generateKeyPoints(raw, keyPoints, sortedPoints);
+            doNotOptimize(sortedPoints);
+        });
+    }
+
+    // --- per frame ---
+    {
+        std::vector<glm::vec3> raw = syntheticTrack(256), keyPoints, points;
+        generateKeyPoints(raw, keyPoints, points);
+        float t = 0.0f;
+        bench.run("getCarPosition", [&] {
+            // golden ratio steps visit the whole track without a pattern the branch predictor can learn
+            t += 0.618034f;
+            if (t >= 1.0f) t -= 1.0f;
+            doNotOptimize(getCarPosition(points, t));
+        });
+
+        // one full car per call, same chain as the main loop
+        glm::mat4 passengerRotation = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, -1.0f, 0.0f));
+        glm::vec3 seatOffsets[8], modelOffsets[8];
+        for (int i = 0; i < 8; i++) {
+            seatOffsets[i] = glm::vec3(0.0f, 0.0f, -0.15f * (i / 2)) + glm::vec3((i % 2) * 0.6f, 0.0f, 0.0f);
+            modelOffsets[i] = glm::vec3(-0.8f, 1.8f, 0.3f);
+        }
+        bench.run("passengerMatrix/8", [&] {
+            t += 0.618034f;
+            if (t >= 1.0f) t -= 1.0f;
+            std::pair<glm::vec3, glm::vec3> car = getCarPosition(points, t);
+            glm::mat4 rotationMatrix = carRotationMatrix(car.second);
+            for (int i = 0; i < 8; i++)
+                doNotOptimize(passengerMatrix(car.first, rotationMatrix, passengerRotation, seatOffsets[i], modelOffsets[i], 1.0f));
+        });
+    }
+
+    // --- station simulation, one simulated day of a busy queue ---
+    {
+        std::vector<glm::vec3> raw = syntheticTrack(256), keyPoints, points;
+        generateKeyPoints(raw, keyPoints, points);
+        for (unsigned int trains : { 1u, 3u }) {
+            GuestFlow flow;
+            flow.params.guests = 10000;
+            flow.params.maxHours = 24.0f;
+            bench.run("GuestFlow/10000guests/" + std::to_string(trains) + "trains", [&] {
+                doNotOptimize(flow.run(points, trains, 0).riders);
+            }, 3);
+        }
+    }
+
+    // --- comfort map, one thread vs all of them ---
+    {
+        std::vector<glm::vec3> raw = syntheticTrack(1024), keyPoints, points;
+        generateKeyPoints(raw, keyPoints, points);
+        // every key point split into 16 so the forces have real work
+        std::vector<glm::vec3> dense;
+        for (size_t i = 0; i < points.size(); i++)
+            for (int s = 0; s < 16; s++)
+                dense.push_back(glm::mix(points[i], points[(i + 1) % points.size()], s / 16.0f));
+        RideParams ride;
+        for (unsigned int threads : { 1u, 0u }) {
+            ComfortMap map;
+            bench.run(std::string("Comfort/") + std::to_string(dense.size()) + "samples/" + (threads ? "1thread" : "allthreads"), [&] {
+                map.analyse(dense, ride, threads);
+                doNotOptimize(map.score);
+            }, 20);
+        }
+    }
+
+    // --- import, CPU side only (no GL context) ---
+    const char* models[] = {
+        "res/tracks.obj", "res/car1.obj", "res/seats.obj", "res/belt.obj",
+        "res/mei/mei.obj", "res/old-lady/old-lady.obj", "res/football-fan/football-fan.obj", "res/person1/person1.obj",
+        "res/person2/person2.obj", "res/soldier/soldier.obj", "res/person3/person3.obj", "res/doctor/doctor.obj"
+    };
+    for (const char* path : models) {
+        if (!fileExists(path)) {
+            std::cout << "skipping Model/" << path << " (missing)\n";
+            continue;
+        }
+        bench.run(std::string("Model/") + path, [&] {
+            Model model(path, false, false);
+            doNotOptimize(model.meshes);
+        }, 5);
+        if (bench.selected(std::string("Model/") + path)) {
+            unsigned long long before = heapAllocations();
+            Model model(path, false, false);
+            std::cout << "  " << heapAllocations() - before << " heap allocations, " << model.meshes.size() << " meshes\n";
+        }
+    }
+
+    const char* textures[] = {
+        "belt.jpg", "plastic.jpg", "student.png", "person2/model_texture.jpg",
+        "old-lady/BGcharacter_cityperson2_Alb.png", "mei/tex/rp_mei_posed_001_dif_2k.jpg"
+    };
+    for (const char* path : textures) {
+        if (!fileExists(std::string("res/") + path)) {
+            std::cout << "skipping decodeTexture/" << path << " (missing)\n";
+            continue;
+        }
+        bench.run(std::string("decodeTexture/") + path, [&] {
+            TextureImage image = decodeTexture(path, "res");
+            doNotOptimize(image.pixels);
+        }, 10);
+    }
+
+    return bench.writeJson() ? 0 : 1;
+}
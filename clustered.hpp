@@ -0,0 +1,246 @@
+#ifndef CLUSTERED_H
+#define CLUSTERED_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+
+// Clustered forward lighting for many point lights.
+//
+// The view frustum is cut into tilesX * tilesY screen tiles and 'slices' exponential depth slices. Every
+// frame the CPU finds the clusters each light's sphere can touch, builds one compact index list per
+// cluster (counting sort, no allocation after create()) and uploads three texture buffers:
+//   uClusterLights   RGBA32F, 2 texels per light: position.xyz, radius / color.rgb, 0
+//   uClusterGrid     RG32UI per cluster: first index, light count
+//   uClusterIndices  R32UI light indices
+// basic.frag (with CLUSTERED defined) picks its cluster from gl_FragCoord and view depth and loops over that
+// cluster's lights only. Texture buffers keep this on GL 3.3, no SSBOs needed.
+
+struct PointLight {
+    glm::vec3 position;     // world space
+    float radius;           // light has no effect past this
+    glm::vec3 color;
+};
+
+class ClusteredLighting
+{
+public:
+    static const unsigned int tilesX = 16;
+    static const unsigned int tilesY = 9;
+    static const unsigned int slices = 24;
+    static const unsigned int clusterCount = tilesX * tilesY * slices;
+    static const unsigned int maxLightsPerCluster = 64;
+
+    // first of the three texture units used, below it stay free for the material maps
+    static const int firstUnit = 8;
+
+    std::vector<PointLight> lights;
+
+    // stats of the last update
+    unsigned int assigned = 0;          // light/cluster pairs
+    unsigned int busiestCluster = 0;    // most lights in one cluster (before the cap)
+
+    bool create(unsigned int maxLights)
+    {
+        capacity = maxLights;
+        lightTexels.resize(capacity * 2);
+        counts.resize(clusterCount);
+        grid.resize(clusterCount * 2);
+        indices.resize(clusterCount * maxLightsPerCluster);
+        lightRanges.resize(capacity);
+
+        glGenBuffers(3, buffers);
+        glGenTextures(3, textures);
+        setupBuffer(0, GL_RGBA32F, capacity * 2 * sizeof(glm::vec4));
+        setupBuffer(1, GL_RG32UI, clusterCount * 2 * sizeof(GLuint));
+        setupBuffer(2, GL_R32UI, indices.size() * sizeof(GLuint));
+        created = true;
+        return true;
+    }
+
+    // needs a current context
+    void release()
+    {
+        if (!created) return;
+        created = false;
+        glDeleteTextures(3, textures);
+        glDeleteBuffers(3, buffers);
+    }
+
+    bool ready() const { return created; }
+
+    // prepended to basic.frag, keeps the shader's grid in sync with the constants above
+    static std::string defines()
+    {
+        return "#define CLUSTERED\n"
+               "#define CLUSTER_TILES_X " + std::to_string(tilesX) + "\n"
+               "#define CLUSTER_TILES_Y " + std::to_string(tilesY) + "\n"
+               "#define CLUSTER_SLICES " + std::to_string(slices) + "\n";
+    }
+
+    // assigns lights to clusters for this view and uploads the buffers. near/far must match the projection.
+    void update(const glm::mat4& view, const glm::mat4& projection, float nearPlane, float farPlane)
+    {
+        PROFILE_SCOPE("light clusters");
+        zNear = nearPlane;
+        zFar = farPlane;
+        sliceScale = (float)slices / std::log(zFar / zNear);
+        sliceBias = -(float)slices * std::log(zNear) / std::log(zFar / zNear);
+
+        unsigned int lightCount = std::min((unsigned int)lights.size(), capacity);
+        std::fill(counts.begin(), counts.end(), 0u);
+        assigned = 0;
+
+        // pass 1: cluster range of every light, count per cluster
+        for (unsigned int i = 0; i < lightCount; i++) {
+            const PointLight& light = lights[i];
+            lightTexels[i * 2 + 0] = glm::vec4(light.position, light.radius);
+            lightTexels[i * 2 + 1] = glm::vec4(light.color, 0.0f);
+
+            ClusterRange& r = lightRanges[i];
+            r.valid = clusterRange(glm::vec3(view * glm::vec4(light.position, 1.0f)), light.radius, projection, r);
+            if (!r.valid) continue;
+            forEachCluster(r, [&](unsigned int c) { counts[c]++; });
+        }
+
+        // prefix sum, capped so a pile of lights in one spot can't overflow the index buffer
+        GLuint offset = 0;
+        busiestCluster = 0;
+        for (unsigned int c = 0; c < clusterCount; c++) {
+            busiestCluster = std::max(busiestCluster, counts[c]);
+            unsigned int n = counts[c] < maxLightsPerCluster ? counts[c] : maxLightsPerCluster;
+            grid[c * 2 + 0] = offset;
+            grid[c * 2 + 1] = 0;
+            offset += n;
+        }
+
+        // pass 2: fill the lists
+        for (unsigned int i = 0; i < lightCount; i++) {
+            const ClusterRange& r = lightRanges[i];
+            if (!r.valid) continue;
+            forEachCluster(r, [&](unsigned int c) {
+                GLuint& n = grid[c * 2 + 1];
+                if (n >= maxLightsPerCluster) return;
+                indices[grid[c * 2] + n] = i;
+                n++;
+                assigned++;
+            });
+        }
+
+        upload(0, lightTexels.data(), lightCount * 2 * sizeof(glm::vec4));
+        upload(1, grid.data(), grid.size() * sizeof(GLuint));
+        upload(2, indices.data(), offset * sizeof(GLuint));
+    }
+
+    // binds the buffers and sets the lookup uniforms, call with the shader in use
+    void bind(Shader& shader) const
+    {
+        static const char* names[3] = { "uClusterLights", "uClusterGrid", "uClusterIndices" };
+        for (int i = 0; i < 3; i++) {
+            glActiveTexture(GL_TEXTURE0 + firstUnit + i);
+            glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+            shader.setInt(names[i], firstUnit + i);
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        shader.setVec2("uClusterTileSize", (float)viewport[2] / tilesX, (float)viewport[3] / tilesY);
+        shader.setVec2("uClusterSlice", sliceScale, sliceBias);
+    }
+
+private:
+    struct ClusterRange {
+        unsigned int x0, x1, y0, y1, z0, z1;
+        bool valid;
+    };
+
+    bool created = false;
+    unsigned int capacity = 0;
+    GLuint buffers[3] = {};
+    GLuint textures[3] = {};
+
+    float zNear = 0.1f, zFar = 100.0f;
+    float sliceScale = 1.0f, sliceBias = 0.0f;
+
+    std::vector<glm::vec4> lightTexels;
+    std::vector<unsigned int> counts;
+    std::vector<GLuint> grid;
+    std::vector<GLuint> indices;
+    std::vector<ClusterRange> lightRanges;
+
+    void setupBuffer(int i, GLenum format, size_t bytes)
+    {
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferData(GL_TEXTURE_BUFFER, std::max<size_t>(bytes, 16), NULL, GL_STREAM_DRAW);
+        glBindTexture(GL_TEXTURE_BUFFER, textures[i]);
+        glTexBuffer(GL_TEXTURE_BUFFER, format, buffers[i]);
+        glBindTexture(GL_TEXTURE_BUFFER, 0);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    void upload(int i, const void* data, size_t bytes)
+    {
+        if (bytes == 0) return;
+        glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, bytes, data);
+        glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    }
+
+    unsigned int slice(float depth) const
+    {
+        float s = std::log(std::max(depth, zNear)) * sliceScale + sliceBias;
+        return (unsigned int)glm::clamp(s, 0.0f, (float)(slices - 1));
+    }
+
+    // conservative tile/slice box of a view space sphere, false if it is outside the frustum depth range
+    bool clusterRange(const glm::vec3& center, float radius, const glm::mat4& projection, ClusterRange& r) const
+    {
+        float depth = -center.z;
+        if (depth + radius < zNear || depth - radius > zFar) return false;
+
+        float dNear = std::max(depth - radius, zNear);
+        float dFar = std::min(depth + radius, zFar);
+        r.z0 = slice(dNear);
+        r.z1 = slice(dFar);
+
+        // x/depth is monotonic in depth, so the extremes of the sphere's box are at the nearest or farthest depth
+        float px = projection[0][0], py = projection[1][1];
+        float xMin = std::min((center.x - radius) / dNear, (center.x - radius) / dFar) * px;
+        float xMax = std::max((center.x + radius) / dNear, (center.x + radius) / dFar) * px;
+        float yMin = std::min((center.y - radius) / dNear, (center.y - radius) / dFar) * py;
+        float yMax = std::max((center.y + radius) / dNear, (center.y + radius) / dFar) * py;
+        if (xMax < -1.0f || xMin > 1.0f || yMax < -1.0f || yMin > 1.0f) return false;
+
+        r.x0 = tile(xMin, tilesX);
+        r.x1 = tile(xMax, tilesX);
+        r.y0 = tile(yMin, tilesY);
+        r.y1 = tile(yMax, tilesY);
+        return true;
+    }
+
+    static unsigned int tile(float ndc, unsigned int count)
+    {
+        float t = (glm::clamp(ndc, -1.0f, 1.0f) * 0.5f + 0.5f) * count;
+        return std::min((unsigned int)t, count - 1);
+    }
+
+    template <typename F>
+    static void forEachCluster(const ClusterRange& r, F f)
+    {
+        for (unsigned int z = r.z0; z <= r.z1; z++)
+            for (unsigned int y = r.y0; y <= r.y1; y++)
+                for (unsigned int x = r.x0; x <= r.x1; x++)
+                    f(x + y * tilesX + z * tilesX * tilesY);
+    }
+};
+
+#endif
@@ -0,0 +1,9 @@
+#version 330 core
+
+in vec3 chColor;
+out vec4 FragColor;
+
+void main()
+{
+    FragColor = vec4(chColor, 1.0);
+}
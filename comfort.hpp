@@ -0,0 +1,376 @@
+#ifndef COMFORT_H
+#define COMFORT_H
+
+#include <glm/glm.hpp>
+
+#include "trains.hpp"
+#include "riders.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define COMFORT_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// G-forces and jerk along a track, for the speed profile the ride physics gives a MOVING train.
+//
+// The speed profile follows the rule TrainManager uses (slope acceleration, clamped to RideParams) and
+// gives the time the train passes every path point. Forces are then finite differences of position over
+// that time, so every sample only needs its neighbours and the samples can be split over threads. Inside
+// a thread four samples go through the force kernel at a time (SSE, same guard as frustum.hpp). Felt
+// force = acceleration - gravity, split into the train's frame: vertical (1 g standing still, along the up
+// vector tilted to the track), lateral and longitudinal. Jerk is the rate of change of that force in g/s.
+//
+// A thread only gets minSamplesPerThread samples or more; below that starting it costs more than the
+// work. The shipped tracks (res/tracks.obj, res/coaster.track) have a few hundred points and are analysed
+// on one thread, only densely sampled paths (the bench, big scenes) are split.
+//
+// Segment k is the path between point k and k + 1, the same mapping TrainManager uses for t.
+struct ComfortLimits {
+    float verticalMax = 4.0f;       // g, pressed into the seat
+    float verticalMin = -1.0f;      // g, lifted out of the seat
+    float lateral = 1.5f;
+    float longitudinal = 1.5f;
+    float jerk = 15.0f;             // g/s
+    float intense = 0.5f;           // score where a segment stops being comfortable, 1 = at a limit
+};
+
+class ComfortMap
+{
+public:
+    ComfortLimits limits;
+    float metersPerUnit = 1.0f;
+
+    // per segment
+    std::vector<float> time;            // seconds since the station
+    std::vector<float> speed;           // m/s
+    std::vector<float> vertical, lateral, longitudinal;    // g
+    std::vector<float> jerk;            // g/s
+    std::vector<float> score;           // worst limit ratio, >= 1 is harsh
+
+    float lapTime = 0.0f;
+    unsigned int threadsUsed = 0;
+    double analyseMs = 0.0;
+
+    // 'threads' = 0 uses every hardware thread (fewer on short paths)
+    void analyse(const std::vector<glm::vec3>& path, const RideParams& ride, unsigned int threads = 0)
+    {
+        PROFILE_SCOPE("ComfortMap::analyse");
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+        unsigned int n = (unsigned int)path.size();
+        clearSamples(n);
+        if (n < 3) return;
+
+        speedProfile(path, ride);
+
+        // padded structure of arrays: [0] is the last point, [n + 1] the first, so the kernel never wraps
+        px.resize(n + 2);
+        py.resize(n + 2);
+        pz.resize(n + 2);
+        tp.resize(n + 2);
+        for (unsigned int k = 0; k < n; k++) {
+            px[k + 1] = path[k].x * metersPerUnit;
+            py[k + 1] = path[k].y * metersPerUnit;
+            pz[k + 1] = path[k].z * metersPerUnit;
+            tp[k + 1] = time[k];
+        }
+        px[0] = px[n]; py[0] = py[n]; pz[0] = pz[n];
+        px[n + 1] = px[1]; py[n + 1] = py[1]; pz[n + 1] = pz[1];
+        tp[0] = time[n - 1] - lapTime;
+        tp[n + 1] = lapTime + time[0];
+
+        if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        threads = std::max(1u, std::min(threads, n / minSamplesPerThread));
+        threadsUsed = threads;
+
+        // jerk needs the forces of both neighbours, so it is a second pass after every force is done
+        parallelFor(n, threads, [this](unsigned int begin, unsigned int end) { forces(begin, end); });
+        parallelFor(n, threads, [this](unsigned int begin, unsigned int end) { jerkAndScore(begin, end); });
+
+        analyseMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+
+    unsigned int segments() const { return (unsigned int)score.size(); }
+
+    // score of the segment a train at track parameter t is on
+    float scoreAt(float t) const
+    {
+        if (score.empty()) return 0.0f;
+        int n = (int)score.size();
+        int k = std::min(std::max((int)(t * n), 0), n - 1);
+        return score[k];
+    }
+
+    // green (comfortable) -> yellow (intense) -> red (at a limit)
+    glm::vec3 color(unsigned int segment) const
+    {
+        const glm::vec3 green(0.2f, 0.9f, 0.2f), yellow(1.0f, 0.85f, 0.1f), red(1.0f, 0.15f, 0.1f);
+        float s = score[segment];
+        if (s < limits.intense) return glm::mix(green, yellow, s / limits.intense);
+        return glm::mix(yellow, red, std::min(1.0f, (s - limits.intense) / (1.0f - limits.intense)));
+    }
+
+    void print(std::ostream& out) const
+    {
+        unsigned int n = segments();
+        if (n == 0) {
+            out << "Comfort map: path too short\n";
+            return;
+        }
+        unsigned int intense = 0, harsh = 0;
+        for (float s : score) {
+            if (s >= 1.0f) harsh++;
+            else if (s >= limits.intense) intense++;
+        }
+        unsigned int vMax = argMax(vertical, 1.0f), vMin = argMax(vertical, -1.0f);
+        unsigned int lat = argMaxAbs(lateral), lon = argMaxAbs(longitudinal), j = argMaxAbs(jerk);
+
+        out << std::fixed << std::setprecision(2)
+            << "Comfort map: " << n << " segments, lap " << lapTime << " s (" << analyseMs << " ms on "
+            << threadsUsed << " threads)\n"
+            << "  " << n - intense - harsh << " comfortable, " << intense << " intense, " << harsh << " harsh\n"
+            << "  vertical " << vertical[vMin] << " g (segment " << vMin << ") to " << vertical[vMax]
+            << " g (segment " << vMax << ")\n"
+            << "  lateral " << lateral[lat] << " g (segment " << lat << "), longitudinal " << longitudinal[lon]
+            << " g (segment " << lon << "), jerk " << jerk[j] << " g/s (segment " << j << ")\n"
+            << std::defaultfloat;
+    }
+
+private:
+    static const unsigned int minSamplesPerThread = 1024;     // a few hundred points take microseconds
+
+    std::vector<float> px, py, pz, tp;
+
+    void clearSamples(unsigned int n)
+    {
+        time.assign(n, 0.0f);
+        speed.assign(n, 0.0f);
+        vertical.assign(n, 1.0f);
+        lateral.assign(n, 0.0f);
+        longitudinal.assign(n, 0.0f);
+        jerk.assign(n, 0.0f);
+        score.assign(n, 0.0f);
+        lapTime = 0.0f;
+        threadsUsed = 0;
+    }
+
+    // the MOVING rule from TrainManager::step per segment: the slope acceleration is constant over a segment,
+    // so v^2 = v0^2 + 2as, clamped like the train's speed. Exact per segment instead of per frame, which would
+    // alias with the sample spacing. Two laps, the second starts at the speed the first one ended with (a
+    // moving train passes the station).
+    void speedProfile(const std::vector<glm::vec3>& path, const RideParams& ride)
+    {
+        int n = (int)path.size();
+        float s = 1.0f / n;
+        float vMin = std::max(ride.minSpeed, 1e-4f);
+        float v = vMin;
+        for (int lap = 0; lap < 2; lap++) {
+            float clock = 0.0f;
+            for (int k = 0; k < n; k++) {
+                time[k] = clock;
+                float a = -(path[(k + 1) % n].y - path[k].y) * ride.gravityFactor;
+                float vNext = glm::clamp(std::sqrt(std::max(v * v + 2.0f * a * s, 0.0f)), vMin, ride.maxSpeed);
+                clock += 2.0f * s / (v + vNext);
+                v = vNext;
+            }
+            lapTime = clock;
+        }
+    }
+
+    template <typename Fn>
+    static void parallelFor(unsigned int count, unsigned int threads, Fn fn)
+    {
+        if (threads <= 1) {
+            fn(0u, count);
+            return;
+        }
+        // chunks are multiples of four so only the last one has a scalar tail
+        unsigned int chunk = ((count + threads - 1) / threads + 3) & ~3u;
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned int begin = chunk; begin < count; begin += chunk)
+            workers.emplace_back(fn, begin, std::min(count, begin + chunk));
+        fn(0u, std::min(count, chunk));
+        for (std::thread& worker : workers) worker.join();
+    }
+
+    // samples [begin, end), sample k is padded index k + 1
+    void forces(unsigned int begin, unsigned int end)
+    {
+        const float g = 9.81f;
+        unsigned int k = begin;
+#ifdef COMFORT_SSE
+        const __m128 one = _mm_set1_ps(1.0f), two = _mm_set1_ps(2.0f), half = _mm_set1_ps(0.5f);
+        const __m128 gravity = _mm_set1_ps(g), invG = _mm_set1_ps(1.0f / g), tiny = _mm_set1_ps(1e-6f);
+        for (; k + 4 <= end; k += 4) {
+            __m128 t0 = _mm_loadu_ps(&tp[k + 1]);
+            __m128 dtm = _mm_max_ps(_mm_sub_ps(t0, _mm_loadu_ps(&tp[k])), tiny);
+            __m128 dtp = _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(&tp[k + 2]), t0), tiny);
+            __m128 invM = _mm_div_ps(one, dtm), invP = _mm_div_ps(one, dtp);
+            __m128 accScale = _mm_div_ps(two, _mm_add_ps(dtm, dtp));
+
+            __m128 vx, vy, vz, ax, ay, az;
+            velocityAcceleration(&px[k], invM, invP, half, accScale, vx, ax);
+            velocityAcceleration(&py[k], invM, invP, half, accScale, vy, ay);
+            velocityAcceleration(&pz[k], invM, invP, half, accScale, vz, az);
+            ay = _mm_add_ps(ay, gravity);
+
+            __m128 v = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, vx), _mm_mul_ps(vy, vy)), _mm_mul_ps(vz, vz)));
+            __m128 invV = _mm_div_ps(one, _mm_max_ps(v, tiny));
+            __m128 tx = _mm_mul_ps(vx, invV), ty = _mm_mul_ps(vy, invV), tz = _mm_mul_ps(vz, invV);
+
+            // up tilted to be perpendicular to the track
+            __m128 ux = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(tx, ty));
+            __m128 uy = _mm_sub_ps(one, _mm_mul_ps(ty, ty));
+            __m128 uz = _mm_sub_ps(_mm_setzero_ps(), _mm_mul_ps(tz, ty));
+            __m128 invU = _mm_div_ps(one, _mm_sqrt_ps(_mm_max_ps(
+                _mm_add_ps(_mm_add_ps(_mm_mul_ps(ux, ux), _mm_mul_ps(uy, uy)), _mm_mul_ps(uz, uz)), tiny)));
+            ux = _mm_mul_ps(ux, invU);
+            uy = _mm_mul_ps(uy, invU);
+            uz = _mm_mul_ps(uz, invU);
+
+            // lateral = forward x up
+            __m128 lx = _mm_sub_ps(_mm_mul_ps(ty, uz), _mm_mul_ps(tz, uy));
+            __m128 ly = _mm_sub_ps(_mm_mul_ps(tz, ux), _mm_mul_ps(tx, uz));
+            __m128 lz = _mm_sub_ps(_mm_mul_ps(tx, uy), _mm_mul_ps(ty, ux));
+
+            _mm_storeu_ps(&speed[k], v);
+            _mm_storeu_ps(&vertical[k], _mm_mul_ps(dot(ax, ay, az, ux, uy, uz), invG));
+            _mm_storeu_ps(&lateral[k], _mm_mul_ps(dot(ax, ay, az, lx, ly, lz), invG));
+            _mm_storeu_ps(&longitudinal[k], _mm_mul_ps(dot(ax, ay, az, tx, ty, tz), invG));
+        }
+#endif
+        for (; k < end; k++) {
+            unsigned int j = k + 1;
+            float dtm = std::max(tp[j] - tp[j - 1], 1e-6f), dtp = std::max(tp[j + 1] - tp[j], 1e-6f);
+            glm::vec3 p0(px[j], py[j], pz[j]);
+            glm::vec3 vm = (p0 - glm::vec3(px[j - 1], py[j - 1], pz[j - 1])) / dtm;
+            glm::vec3 vp = (glm::vec3(px[j + 1], py[j + 1], pz[j + 1]) - p0) / dtp;
+            glm::vec3 velocity = 0.5f * (vm + vp);
+            glm::vec3 felt = (vp - vm) * (2.0f / (dtm + dtp)) + glm::vec3(0.0f, g, 0.0f);
+
+            float v = glm::length(velocity);
+            glm::vec3 forward = velocity / std::max(v, 1e-6f);
+            glm::vec3 up(-forward.x * forward.y, 1.0f - forward.y * forward.y, -forward.z * forward.y);
+            up /= std::sqrt(std::max(glm::dot(up, up), 1e-6f));
+            glm::vec3 side = glm::cross(forward, up);
+
+            speed[k] = v;
+            vertical[k] = glm::dot(felt, up) / g;
+            lateral[k] = glm::dot(felt, side) / g;
+            longitudinal[k] = glm::dot(felt, forward) / g;
+        }
+    }
+
+#ifdef COMFORT_SSE
+    // central differences of one coordinate for four samples, p points at the previous sample
+    static void velocityAcceleration(const float* p, __m128 invM, __m128 invP, __m128 half, __m128 accScale, __m128& velocity, __m128& acceleration)
+    {
+        __m128 p0 = _mm_loadu_ps(p + 1);
+        __m128 vm = _mm_mul_ps(_mm_sub_ps(p0, _mm_loadu_ps(p)), invM);
+        __m128 vp = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(p + 2), p0), invP);
+        velocity = _mm_mul_ps(_mm_add_ps(vm, vp), half);
+        acceleration = _mm_mul_ps(_mm_sub_ps(vp, vm), accScale);
+    }
+
+    static __m128 dot(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+    {
+        return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+    }
+#endif
+
+    void jerkAndScore(unsigned int begin, unsigned int end)
+    {
+        unsigned int n = (unsigned int)score.size();
+        for (unsigned int k = begin; k < end; k++) {
+            unsigned int prev = k ? k - 1 : n - 1, next = k + 1 < n ? k + 1 : 0;
+            float dt = std::max(tp[k + 2] - tp[k], 1e-6f);
+            float dv = vertical[next] - vertical[prev];
+            float dl = lateral[next] - lateral[prev];
+            float dx = longitudinal[next] - longitudinal[prev];
+            jerk[k] = std::sqrt(dv * dv + dl * dl + dx * dx) / dt;
+
+            float v = vertical[k];
+            float s = v > 1.0f ? (v - 1.0f) / (limits.verticalMax - 1.0f) : (1.0f - v) / (1.0f - limits.verticalMin);
+            s = std::max(s, std::fabs(lateral[k]) / limits.lateral);
+            s = std::max(s, std::fabs(longitudinal[k]) / limits.longitudinal);
+            s = std::max(s, jerk[k] / limits.jerk);
+            score[k] = s;
+        }
+    }
+
+    // index of the largest value * sign
+    static unsigned int argMax(const std::vector<float>& values, float sign)
+    {
+        unsigned int best = 0;
+        for (unsigned int i = 1; i < values.size(); i++)
+            if (values[i] * sign > values[best] * sign) best = i;
+        return best;
+    }
+
+    static unsigned int argMaxAbs(const std::vector<float>& values)
+    {
+        unsigned int best = 0;
+        for (unsigned int i = 1; i < values.size(); i++)
+            if (std::fabs(values[i]) > std::fabs(values[best])) best = i;
+        return best;
+    }
+};
+
+// Motion sickness of the riders, driven by the comfort map instead of a keypress. Time on segments above
+// the intense score adds to a rider's dose (1 per second at a limit, more beyond it), comfortable track
+// lets it recover. Every rider gets their own tolerance when boarding, drawn around 'tolerance' from a
+// fixed seed so replays stay deterministic.
+class SicknessModel
+{
+public:
+    float tolerance = 3.0f;         // average dose until a rider is sick
+    float recovery = 0.25f;         // dose per second lost on comfortable track
+
+    // seats that got sick in the last update()
+    std::vector<unsigned int> becameSick;
+
+    void resize(unsigned int seats)
+    {
+        dose.assign(seats, 0.0f);
+        limit.assign(seats, tolerance);
+        becameSick.reserve(seats);
+    }
+
+    void board(unsigned int seat)
+    {
+        std::uniform_real_distribution<float> spread(0.5f, 1.5f);
+        dose[seat] = 0.0f;
+        limit[seat] = tolerance * spread(rng);
+    }
+
+    // 'score' is the comfort score under the rider train this frame
+    void update(const RiderSeats& riders, float score, float intense, float deltaTime)
+    {
+        becameSick.clear();
+        float rate = score > intense ? (score - intense) / (1.0f - intense) : -recovery;
+        for (unsigned int seat : riders.active()) {
+            if (riders.isSick(seat)) continue;
+            dose[seat] = std::max(0.0f, dose[seat] + rate * deltaTime);
+            if (dose[seat] >= limit[seat]) becameSick.push_back(seat);
+        }
+    }
+
+    float doseOf(unsigned int seat) const { return dose[seat]; }
+
+private:
+    std::vector<float> dose, limit;
+    std::mt19937 rng{ 3u };
+};
+
+#endif
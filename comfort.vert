@@ -0,0 +1,15 @@
+#version 330 core
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inColor;
+
+// comfort map line over the rider track (comfort.hpp), already in world space
+uniform mat4 uP;
+uniform mat4 uV;
+
+out vec3 chColor;
+
+void main()
+{
+    gl_Position = uP * uV * vec4(inPos, 1.0);
+    chColor = inColor;
+}
@@ -0,0 +1,234 @@
+#ifndef DEFERRED_H
+#define DEFERRED_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "shader.hpp"
+#include "profiler.hpp"
+
+#include <iomanip>
+#include <iostream>
+
+// Deferred shading path.
+//
+// The geometry pass draws the scene with basic.frag compiled with GBUFFER: no lighting, it only writes
+// albedo (texture * tint) and the world normal; depth goes to a depth texture. The lighting pass is one
+// full screen triangle with basic.frag compiled with DEFERRED_LIGHTING, which rebuilds the world position
+// from depth and runs the same lighting code as the forward path (sun, shadows, park lights), once per
+// pixel instead of once per overdrawn fragment. Depth is copied back afterwards so anything drawn later
+// still depth tests against the scene.
+class GBuffer
+{
+public:
+    // texture units of the lighting pass
+    static const int albedoUnit = 0;
+    static const int normalUnit = 1;
+    static const int depthUnit = 2;
+
+    // sized lazily in begin() to the current viewport
+    bool create()
+    {
+        glGenVertexArrays(1, &emptyVAO);    // the full screen triangle comes from gl_VertexID
+        created = true;
+        return true;
+    }
+
+    void release()
+    {
+        releaseTargets();
+        if (emptyVAO) glDeleteVertexArrays(1, &emptyVAO);
+        emptyVAO = 0;
+        created = false;
+    }
+
+    bool ready() const { return created; }
+
+    // binds and clears the G-buffer, call before the geometry pass
+    void begin()
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        if (viewport[2] != width || viewport[3] != height) {
+            releaseTargets();
+            if (!createTargets(viewport[2], viewport[3]))
+                std::cout << "ERROR::DEFERRED:: framebuffer not complete" << std::endl;
+        }
+
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    // back to the previous framebuffer and runs the lighting pass into it. The lighting shader must be in
+    // use with its light, shadow and cluster uniforms already set.
+    void light(Shader& lightingShader, const glm::mat4& viewProjection)
+    {
+        PROFILE_SCOPE("deferred lighting");
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+
+        glActiveTexture(GL_TEXTURE0 + albedoUnit);
+        glBindTexture(GL_TEXTURE_2D, albedo);
+        glActiveTexture(GL_TEXTURE0 + normalUnit);
+        glBindTexture(GL_TEXTURE_2D, normal);
+        glActiveTexture(GL_TEXTURE0 + depthUnit);
+        glBindTexture(GL_TEXTURE_2D, depth);
+        glActiveTexture(GL_TEXTURE0);
+
+        lightingShader.setInt("uGAlbedo", albedoUnit);
+        lightingShader.setInt("uGNormal", normalUnit);
+        lightingShader.setInt("uGDepth", depthUnit);
+        lightingShader.setMat4("uInvViewProj", glm::inverse(viewProjection));
+
+        GLboolean depthTest = glIsEnabled(GL_DEPTH_TEST);
+        glDisable(GL_DEPTH_TEST);
+        glBindVertexArray(emptyVAO);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        glBindVertexArray(0);
+        if (depthTest) glEnable(GL_DEPTH_TEST);
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, FBO);
+        glBindFramebuffer(GL_DRAW_FRAMEBUFFER, previousFramebuffer);
+        glBlitFramebuffer(0, 0, width, height, 0, 0, width, height, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+    }
+
+private:
+    bool created = false;
+    int width = 0, height = 0;
+    GLuint FBO = 0;
+    GLuint albedo = 0, normal = 0, depth = 0;
+    GLuint emptyVAO = 0;
+    GLint previousFramebuffer = 0;
+
+    static GLuint target(GLint internalFormat, GLenum format, GLenum type, int w, int h)
+    {
+        GLuint texture;
+        glGenTextures(1, &texture);
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, w, h, 0, format, type, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+        return texture;
+    }
+
+    bool createTargets(int w, int h)
+    {
+        width = w;
+        height = h;
+        albedo = target(GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, w, h);
+        normal = target(GL_RGBA16F, GL_RGBA, GL_FLOAT, w, h);
+        // same format as the window / offscreen depth so it can be blitted back
+        depth = target(GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, w, h);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, albedo, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT1, GL_TEXTURE_2D, normal, 0);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_TEXTURE_2D, depth, 0);
+        GLenum buffers[2] = { GL_COLOR_ATTACHMENT0, GL_COLOR_ATTACHMENT1 };
+        glDrawBuffers(2, buffers);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        return complete;
+    }
+
+    void releaseTargets()
+    {
+        if (!FBO) return;
+        glDeleteFramebuffers(1, &FBO);
+        GLuint textures[3] = { albedo, normal, depth };
+        glDeleteTextures(3, textures);
+        FBO = albedo = normal = depth = 0;
+        width = height = 0;
+    }
+};
+
+// GPU time of the scene pass per shading path, from timestamp queries so it works next to the profiler's
+// GL_TIME_ELAPSED spans. Results are read back a few frames late without stalling.
+class ShadingTimer
+{
+public:
+    enum Path { FORWARD = 0, DEFERRED = 1 };
+
+    void create()
+    {
+        glGenQueries(ringSize * 2, queries);
+        created = true;
+    }
+
+    void release()
+    {
+        if (!created) return;
+        glDeleteQueries(ringSize * 2, queries);
+        created = false;
+    }
+
+    void begin(Path path)
+    {
+        if (!created || pending[next]) return;     // every slot still in flight, skip this frame
+        glQueryCounter(queries[next * 2], GL_TIMESTAMP);
+        slotPath[next] = path;
+        active = true;
+    }
+
+    void end()
+    {
+        if (!active) return;
+        glQueryCounter(queries[next * 2 + 1], GL_TIMESTAMP);
+        pending[next] = true;
+        active = false;
+        next = (next + 1) % ringSize;
+    }
+
+    void collect()
+    {
+        if (!created) return;
+        for (int i = 0; i < ringSize; i++) {
+            if (!pending[i]) continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[i * 2 + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;
+
+            GLuint64 start = 0, stop = 0;
+            glGetQueryObjectui64v(queries[i * 2], GL_QUERY_RESULT, &start);
+            glGetQueryObjectui64v(queries[i * 2 + 1], GL_QUERY_RESULT, &stop);
+            totalNs[slotPath[i]] += (double)(stop - start);
+            frames[slotPath[i]]++;
+            pending[i] = false;
+        }
+    }
+
+    // average scene GPU time of both paths since the last report, then starts over
+    void report(std::ostream& out)
+    {
+        static const char* names[2] = { "forward", "deferred" };
+        out << "Scene GPU time:";
+        for (int p = 0; p < 2; p++) {
+            out << " " << names[p] << " ";
+            if (frames[p] == 0) out << "-";
+            else out << std::fixed << std::setprecision(3) << totalNs[p] / frames[p] * 1e-6 << " ms (" << frames[p] << " frames)";
+            totalNs[p] = 0.0;
+            frames[p] = 0;
+        }
+        out << std::defaultfloat << "\n";
+    }
+
+private:
+    static const int ringSize = 8;
+    bool created = false;
+    bool active = false;
+    int next = 0;
+    GLuint queries[ringSize * 2] = {};
+    bool pending[ringSize] = {};
+    Path slotPath[ringSize] = {};
+    double totalNs[2] = {};
+    unsigned int frames[2] = {};
+};
+
+#endif
@@ -0,0 +1,177 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <glm/glm.hpp>
+
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define FRUSTUM_SSE 1
+#include <xmmintrin.h>
+#endif
+
+// counters for one frame, filled by Model::Draw when a frustum is passed in
+struct CullStats {
+    unsigned int drawn = 0;
+    unsigned int culled = 0;
+
+    void reset()
+    {
+        drawn = 0;
+        culled = 0;
+    }
+};
+
+class Frustum
+{
+public:
+    // planes stored as structure of arrays (a*x + b*y + c*z + d >= 0 is inside).
+    // 6 planes padded to 8 so the loops stay branch free.
+    alignas(16) float a[8];
+    alignas(16) float b[8];
+    alignas(16) float c[8];
+    alignas(16) float d[8];
+
+    Frustum()
+    {
+        for (int i = 0; i < 8; i++) {
+            a[i] = 0.0f; b[i] = 0.0f; c[i] = 0.0f; d[i] = 1.0f;
+        }
+    }
+
+    // extracts the planes from a projection * view matrix (Gribb/Hartmann)
+    void extract(const glm::mat4& viewProjection)
+    {
+        const glm::mat4& m = viewProjection;
+        glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+        glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+        glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+        glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+
+        glm::vec4 planes[6] = {
+            row3 + row0,    // left
+            row3 - row0,    // right
+            row3 + row1,    // bottom
+            row3 - row1,    // top
+            row3 + row2,    // near
+            row3 - row2     // far
+        };
+
+        for (int i = 0; i < 6; i++) {
+            float len = glm::length(glm::vec3(planes[i]));
+            if (len > 0.0f) planes[i] = planes[i] / len;
+            a[i] = planes[i].x;
+            b[i] = planes[i].y;
+            c[i] = planes[i].z;
+            d[i] = planes[i].w;
+        }
+        // padding planes always pass
+        for (int i = 6; i < 8; i++) {
+            a[i] = 0.0f; b[i] = 0.0f; c[i] = 0.0f; d[i] = 1.0f;
+        }
+    }
+
+    // tests 'count' world space spheres given as separate x/y/z/radius arrays.
+    // visible[i] is set to 1 if sphere i touches the frustum, 0 if it is fully outside.
+    void testSpheres(const float* cx, const float* cy, const float* cz, const float* r, int count, unsigned char* visible) const
+    {
+        int i = 0;
+#ifdef FRUSTUM_SSE
+        // 4 spheres at a time against each plane
+        for (; i + 4 <= count; i += 4) {
+            __m128 x = _mm_loadu_ps(cx + i);
+            __m128 y = _mm_loadu_ps(cy + i);
+            __m128 z = _mm_loadu_ps(cz + i);
+            __m128 negR = _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(r + i));
+            __m128 inside = _mm_cmpeq_ps(x, x);  // all bits set
+
+            for (int p = 0; p < 6; p++) {
+                __m128 dist = _mm_add_ps(
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[p]), x), _mm_mul_ps(_mm_set1_ps(b[p]), y)),
+                    _mm_add_ps(_mm_mul_ps(_mm_set1_ps(c[p]), z), _mm_set1_ps(d[p])));
+                inside = _mm_and_ps(inside, _mm_cmpge_ps(dist, negR));
+            }
+
+            int mask = _mm_movemask_ps(inside);
+            visible[i + 0] = (mask >> 0) & 1;
+            visible[i + 1] = (mask >> 1) & 1;
+            visible[i + 2] = (mask >> 2) & 1;
+            visible[i + 3] = (mask >> 3) & 1;
+        }
+#endif
+        for (; i < count; i++) {
+            bool inside = true;
+            for (int p = 0; p < 6; p++) {
+                float dist = a[p] * cx[i] + b[p] * cy[i] + c[p] * cz[i] + d[p];
+                inside = inside && dist >= -r[i];
+            }
+            visible[i] = inside ? 1 : 0;
+        }
+    }
+
+    // single sphere version, used for the quick whole-model reject
+    bool testSphere(const glm::vec3& center, float radius) const
+    {
+        unsigned char visible;
+        testSpheres(&center.x, &center.y, &center.z, &radius, 1, &visible);
+        return visible != 0;
+    }
+
+    // sphere swept from 'center' along the unit 'direction' for 'length', e.g. a shadow caster and everything its
+    // shadow can fall on. Conservative: only rejected when both ends are behind the same plane.
+    bool testSweptSphere(const glm::vec3& center, float radius, const glm::vec3& direction, float length) const
+    {
+        glm::vec3 end = center + direction * length;
+        for (int p = 0; p < 6; p++) {
+            float start = a[p] * center.x + b[p] * center.y + c[p] * center.z + d[p];
+            float stop = a[p] * end.x + b[p] * end.y + c[p] * end.z + d[p];
+            if (start < -radius && stop < -radius) return false;
+        }
+        return true;
+    }
+
+    // world space box given as center and half extents, tested against the plane's "positive" corner
+    bool testBox(const glm::vec3& center, const glm::vec3& extents) const
+    {
+        for (int p = 0; p < 6; p++) {
+            float dist = a[p] * center.x + b[p] * center.y + c[p] * center.z + d[p];
+            float reach = extents.x * fabsf(a[p]) + extents.y * fabsf(b[p]) + extents.z * fabsf(c[p]);
+            if (dist + reach < 0.0f) return false;
+        }
+        return true;
+    }
+};
+
+// radius scale for a sphere under a model matrix (largest axis scale)
+inline float maxAxisScale(const glm::mat4& m)
+{
+    float sx = glm::length(glm::vec3(m[0]));
+    float sy = glm::length(glm::vec3(m[1]));
+    float sz = glm::length(glm::vec3(m[2]));
+    return glm::max(sx, glm::max(sy, sz));
+}
+
+// moves an object space box into world space, result is again an axis aligned box (center + half extents)
+inline void transformBox(const glm::mat4& m, const glm::vec3& boxMin, const glm::vec3& boxMax, glm::vec3& center, glm::vec3& extents)
+{
+    glm::vec3 localCenter = (boxMin + boxMax) * 0.5f;
+    glm::vec3 localExtents = (boxMax - boxMin) * 0.5f;
+
+    center = glm::vec3(m * glm::vec4(localCenter, 1.0f));
+    extents = glm::abs(glm::vec3(m[0])) * localExtents.x
+            + glm::abs(glm::vec3(m[1])) * localExtents.y
+            + glm::abs(glm::vec3(m[2])) * localExtents.z;
+}
+
+// smallest sphere around two spheres (xyz center, w radius)
+inline glm::vec4 mergeSpheres(const glm::vec4& a, const glm::vec4& b)
+{
+    float distance = glm::length(glm::vec3(b) - glm::vec3(a));
+    if (distance + b.w <= a.w) return a;
+    if (distance + a.w <= b.w) return b;
+    float radius = (distance + a.w + b.w) * 0.5f;
+    glm::vec3 center = glm::vec3(a) + (glm::vec3(b) - glm::vec3(a)) * ((radius - a.w) / distance);
+    return glm::vec4(center, radius);
+}
+
+#endif
@@ -0,0 +1,216 @@
+#ifndef GUESTFLOW_H
+#define GUESTFLOW_H
+
+#include <glm/glm.hpp>
+
+#include "trains.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+// Station throughput simulation for capacity planning, no window or GL needed.
+//
+// Guests arrive at the queue as a Poisson process and are stored structure of arrays. Arrival times are
+// generated sorted and the queue is first come first served, so the queue is just the index range
+// [nextToBoard, arrived) and a train's riders are one contiguous index range too; nothing is allocated
+// per step. Trains are a TrainManager with station stops on: a train that reaches t = 0 goes STOPPED and
+// runs the same lifecycle the rider train has with the keyboard:
+//   unload -> boarding (allowBoarding) -> belt check (every belt on) -> dispatch (MOVING)
+// Dispatch also waits for the minimum interval since the previous dispatch. The block system keeps the
+// next train out of the station while one is in it.
+struct GuestFlowParams {
+    unsigned int guests = 10000;
+    float arrivalsPerHour = 500.0f;
+    unsigned int seatsPerTrain = 8;
+    float unloadTime = 20.0f;           // seconds from stop until the seats are free
+    float boardTimePerRow = 3.0f;       // guests board two abreast, like the car's seats
+    float beltCheckTime = 15.0f;        // operator walks the train, allBelts in startRide
+    float dispatchInterval = 30.0f;     // minimum seconds between two dispatches
+    float timeStep = 1.0f / 30.0f;
+    float maxHours = 48.0f;             // stop even if the queue never drains
+    unsigned int seed = 11;
+};
+
+struct GuestFlowReport {
+    double simulatedSeconds = 0.0;
+    double wallSeconds = 0.0;
+    unsigned int dispatches = 0;
+    unsigned int riders = 0;            // boarded and dispatched
+    unsigned int unserved = 0;          // still queued or not arrived when the simulation stopped
+    double ridersPerHour = 0.0;
+    double meanTrainFill = 0.0;         // riders per dispatch / seats
+    float waitP50 = 0.0f, waitP90 = 0.0f, waitP99 = 0.0f, waitMax = 0.0f;   // seconds in the queue
+
+    void print(std::ostream& out) const
+    {
+        out << std::fixed << std::setprecision(1)
+            << "Guest flow: " << riders << " riders in " << simulatedSeconds / 3600.0 << " h simulated ("
+            << wallSeconds * 1000.0 << " ms, " << (wallSeconds > 0.0 ? simulatedSeconds / wallSeconds : 0.0) << "x real time)\n"
+            << "  throughput: " << ridersPerHour << " riders/h, " << dispatches << " dispatches, "
+            << meanTrainFill * 100.0 << "% average train fill\n"
+            << "  queue wait: p50 " << waitP50 / 60.0f << " min, p90 " << waitP90 / 60.0f << " min, p99 "
+            << waitP99 / 60.0f << " min, max " << waitMax / 60.0f << " min\n";
+        if (unserved) out << "  " << unserved << " guests not served before the time limit\n";
+        out << std::defaultfloat;
+    }
+};
+
+class GuestFlow
+{
+public:
+    GuestFlowParams params;
+
+    // 'path' is a track loop from generateKeyPoints, the simulation runs its own trains on it
+    GuestFlowReport run(const std::vector<glm::vec3>& path, unsigned int trainCount, unsigned int blockCount)
+    {
+        PROFILE_SCOPE("GuestFlow::run");
+        std::chrono::steady_clock::time_point wallStart = std::chrono::steady_clock::now();
+        GuestFlowReport report;
+
+        spawnGuests();
+
+        TrainManager trains;
+        trains.stationStops = true;
+        trains.init(path, trainCount, blockCount ? blockCount : std::max(16u, trainCount * 3));
+        unsigned int count = trains.count();
+        phase.assign(count, RUNNING);
+        phaseTimer.assign(count, 0.0f);
+        riderCount.assign(count, 0);
+
+        unsigned int arrived = 0, nextToBoard = 0;
+        double time = 0.0, lastDispatch = -1e9;
+        double maxTime = params.maxHours * 3600.0;
+        float dt = params.timeStep;
+        unsigned int guests = (unsigned int)arrival.size();
+
+        while (time < maxTime && (nextToBoard < guests || anyRiders())) {
+            while (arrived < guests && arrival[arrived] <= time) arrived++;
+
+            trains.update(dt);
+
+            for (unsigned int i = 0; i < count; i++) {
+                switch (phase[i]) {
+                case RUNNING:
+                    if (trains.state[i] == STOPPED) {
+                        phase[i] = UNLOADING;
+                        phaseTimer[i] = riderCount[i] ? params.unloadTime : 0.0f;
+                    }
+                    break;
+                case UNLOADING:
+                    phaseTimer[i] -= dt;
+                    if (phaseTimer[i] <= 0.0f) {
+                        riderCount[i] = 0;
+                        phase[i] = BOARDING;
+                        phaseTimer[i] = 0.0f;
+                    }
+                    break;
+                case BOARDING:
+                    // one row of two every boardTimePerRow while there are seats and guests in the queue
+                    phaseTimer[i] += dt;
+                    while (phaseTimer[i] >= params.boardTimePerRow && riderCount[i] < params.seatsPerTrain && nextToBoard < arrived) {
+                        phaseTimer[i] -= params.boardTimePerRow;
+                        for (int k = 0; k < 2 && riderCount[i] < params.seatsPerTrain && nextToBoard < arrived; k++) {
+                            boarded[nextToBoard++] = (float)time;
+                            riderCount[i]++;
+                        }
+                    }
+                    // full, or nobody waiting and the dispatch slot has come (an empty queue must not stall the line)
+                    if (riderCount[i] == params.seatsPerTrain ||
+                        (nextToBoard == arrived && riderCount[i] > 0 && time - lastDispatch >= params.dispatchInterval) ||
+                        (nextToBoard == guests && riderCount[i] == 0)) {
+                        phase[i] = BELT_CHECK;
+                        phaseTimer[i] = riderCount[i] ? params.beltCheckTime : 0.0f;
+                    }
+                    else if (phaseTimer[i] > params.boardTimePerRow) {
+                        phaseTimer[i] = params.boardTimePerRow;     // don't bank boarding time while the queue is empty
+                    }
+                    break;
+                case BELT_CHECK:
+                    phaseTimer[i] -= dt;
+                    if (phaseTimer[i] <= 0.0f && time - lastDispatch >= params.dispatchInterval) {
+                        trains.state[i] = MOVING;   // same as startRide: every belt is on, boarding closes
+                        phase[i] = RUNNING;
+                        lastDispatch = time;
+                        if (riderCount[i]) {
+                            report.dispatches++;
+                            report.riders += riderCount[i];
+                        }
+                    }
+                    break;
+                }
+            }
+            time += dt;
+        }
+
+        report.simulatedSeconds = time;
+        report.unserved = guests - nextToBoard;
+        report.ridersPerHour = time > 0.0 ? report.riders / (time / 3600.0) : 0.0;
+        report.meanTrainFill = report.dispatches ? (double)report.riders / report.dispatches / params.seatsPerTrain : 0.0;
+        waitPercentiles(nextToBoard, report);
+        report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+        return report;
+    }
+
+private:
+    enum StationPhase : uint8_t { RUNNING, UNLOADING, BOARDING, BELT_CHECK };
+
+    // per guest, index = arrival order
+    std::vector<float> arrival;
+    std::vector<float> boarded;
+
+    // per train
+    std::vector<StationPhase> phase;
+    std::vector<float> phaseTimer;
+    std::vector<unsigned int> riderCount;
+
+    std::vector<float> waits;
+
+    void spawnGuests()
+    {
+        std::mt19937 rng(params.seed);
+        std::exponential_distribution<float> gap(params.arrivalsPerHour / 3600.0f);
+        arrival.resize(params.guests);
+        boarded.assign(params.guests, -1.0f);
+        float time = 0.0f;
+        for (unsigned int g = 0; g < params.guests; g++) {
+            time += gap(rng);
+            arrival[g] = time;
+        }
+    }
+
+    bool anyRiders() const
+    {
+        for (unsigned int n : riderCount)
+            if (n) return true;
+        return false;
+    }
+
+    void waitPercentiles(unsigned int boardedCount, GuestFlowReport& report)
+    {
+        if (boardedCount == 0) return;
+        waits.resize(boardedCount);
+        for (unsigned int g = 0; g < boardedCount; g++)
+            waits[g] = boarded[g] - arrival[g];
+
+        report.waitP50 = percentile(0.50f);
+        report.waitP90 = percentile(0.90f);
+        report.waitP99 = percentile(0.99f);
+        report.waitMax = *std::max_element(waits.begin(), waits.end());
+    }
+
+    float percentile(float p)
+    {
+        size_t k = std::min(waits.size() - 1, (size_t)(p * waits.size()));
+        std::nth_element(waits.begin(), waits.begin() + k, waits.end());
+        return waits[k];
+    }
+};
+
+#endif
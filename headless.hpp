@@ -0,0 +1,334 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+// Offscreen benchmark mode: no monitor needed, renders into an FBO, follows a scripted camera
+// for a fixed number of frames and writes per frame timings (and optionally PNG captures).
+
+struct HeadlessOptions {
+    bool enabled = false;
+    int width = 1280;
+    int height = 720;
+    int frames = 600;                   // with --replay and no --frames, the replay's frame count
+    bool framesGiven = false;
+    float frameStep = 1.0f / 60.0f;     // fixed deltaTime so every run simulates the same ride
+    std::string timingsPath = "headless_timings.csv";
+    std::string captureDir;             // empty = no captures
+    int captureEvery = 60;
+};
+
+// tries, in order: GLFW null platform + OSMesa (no display at all), then a hidden window on the
+// default platform (e.g. Mesa llvmpipe with LIBGL_ALWAYS_SOFTWARE=1), once with the native and once with the EGL context API.
+// Calls glfwInit itself.
+inline GLFWwindow* createHeadlessWindow(int major, int minor)
+{
+    struct Attempt { int platform; int contextApi; const char* name; };
+    std::vector<Attempt> attempts;
+#ifdef GLFW_PLATFORM_NULL
+    attempts.push_back({ GLFW_PLATFORM_NULL, GLFW_OSMESA_CONTEXT_API, "null platform + OSMesa" });
+    attempts.push_back({ GLFW_ANY_PLATFORM, GLFW_NATIVE_CONTEXT_API, "hidden window" });
+    attempts.push_back({ GLFW_ANY_PLATFORM, GLFW_EGL_CONTEXT_API, "hidden window + EGL" });
+#else
+    attempts.push_back({ 0, GLFW_NATIVE_CONTEXT_API, "hidden window" });
+    attempts.push_back({ 0, GLFW_EGL_CONTEXT_API, "hidden window + EGL" });
+#endif
+
+    for (const Attempt& attempt : attempts) {
+#ifdef GLFW_PLATFORM_NULL
+        glfwInitHint(GLFW_PLATFORM, attempt.platform);
+#endif
+        if (!glfwInit()) continue;
+
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, major);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, minor);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, attempt.contextApi);
+
+        // the window itself is never shown, everything goes into the FBO
+        GLFWwindow* window = glfwCreateWindow(64, 64, "headless", NULL, NULL);
+        if (window) {
+            std::cout << "Headless context: " << attempt.name << "\n";
+            return window;
+        }
+        glfwTerminate();
+    }
+    return NULL;
+}
+
+class OffscreenTarget
+{
+public:
+    unsigned int FBO = 0;
+    int width = 0;
+    int height = 0;
+
+    bool create(int w, int h)
+    {
+        width = w;
+        height = h;
+
+        glGenFramebuffers(1, &FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+        glGenRenderbuffers(1, &colorRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorRBO);
+
+        glGenRenderbuffers(1, &depthRBO);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthRBO);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthRBO);
+
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        if (!complete) std::cout << "ERROR::HEADLESS:: framebuffer not complete" << std::endl;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    void bind() const
+    {
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glViewport(0, 0, width, height);
+    }
+
+    // rgba rows, top row first
+    void readPixels(std::vector<unsigned char>& pixels) const
+    {
+        pixels.resize((size_t)width * height * 4);
+        glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        // GL starts at the bottom
+        size_t rowBytes = (size_t)width * 4;
+        for (int y = 0; y < height / 2; y++)
+            std::swap_ranges(pixels.begin() + y * rowBytes, pixels.begin() + (y + 1) * rowBytes, pixels.begin() + (height - 1 - y) * rowBytes);
+    }
+
+    void release()
+    {
+        if (!FBO) return;
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteRenderbuffers(1, &colorRBO);
+        glDeleteRenderbuffers(1, &depthRBO);
+        FBO = 0;
+    }
+
+private:
+    unsigned int colorRBO = 0;
+    unsigned int depthRBO = 0;
+};
+
+// ================= PNG =================
+// minimal writer, uncompressed deflate blocks; captures are for diffing, not for size
+
+inline uint32_t pngCrc(const unsigned char* data, size_t length, uint32_t crc = 0xFFFFFFFFu)
+{
+    static uint32_t table[256];
+    static bool tableReady = false;
+    if (!tableReady) {
+        for (uint32_t n = 0; n < 256; n++) {
+            uint32_t c = n;
+            for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[n] = c;
+        }
+        tableReady = true;
+    }
+    for (size_t i = 0; i < length; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc;
+}
+
+inline void pngPutU32(std::vector<unsigned char>& out, uint32_t v)
+{
+    out.push_back((v >> 24) & 0xFF);
+    out.push_back((v >> 16) & 0xFF);
+    out.push_back((v >> 8) & 0xFF);
+    out.push_back(v & 0xFF);
+}
+
+inline void pngChunk(std::ofstream& file, const char* type, const std::vector<unsigned char>& data)
+{
+    std::vector<unsigned char> chunk;
+    pngPutU32(chunk, (uint32_t)data.size());
+    chunk.insert(chunk.end(), type, type + 4);
+    chunk.insert(chunk.end(), data.begin(), data.end());
+    uint32_t crc = pngCrc(chunk.data() + 4, chunk.size() - 4) ^ 0xFFFFFFFFu;
+    pngPutU32(chunk, crc);
+    file.write((const char*)chunk.data(), chunk.size());
+}
+
+inline bool writePNG(const std::string& path, int width, int height, const std::vector<unsigned char>& rgba)
+{
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open()) return false;
+
+    static const unsigned char signature[8] = { 137, 80, 78, 71, 13, 10, 26, 10 };
+    file.write((const char*)signature, 8);
+
+    std::vector<unsigned char> header;
+    pngPutU32(header, (uint32_t)width);
+    pngPutU32(header, (uint32_t)height);
+    header.push_back(8);    // bit depth
+    header.push_back(6);    // RGBA
+    header.push_back(0);
+    header.push_back(0);
+    header.push_back(0);
+    pngChunk(file, "IHDR", header);
+
+    // scanlines with filter byte 0
+    size_t rowBytes = (size_t)width * 4;
+    std::vector<unsigned char> raw;
+    raw.reserve((rowBytes + 1) * height);
+    for (int y = 0; y < height; y++) {
+        raw.push_back(0);
+        raw.insert(raw.end(), rgba.begin() + y * rowBytes, rgba.begin() + (y + 1) * rowBytes);
+    }
+
+    // zlib stream of stored blocks
+    std::vector<unsigned char> z;
+    z.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    z.push_back(0x78);
+    z.push_back(0x01);
+    uint32_t a = 1, b = 0;
+    size_t pos = 0;
+    do {
+        size_t blockSize = std::min<size_t>(65535, raw.size() - pos);
+        bool last = pos + blockSize == raw.size();
+        z.push_back(last ? 1 : 0);
+        z.push_back(blockSize & 0xFF);
+        z.push_back((blockSize >> 8) & 0xFF);
+        z.push_back(~blockSize & 0xFF);
+        z.push_back((~blockSize >> 8) & 0xFF);
+        for (size_t i = 0; i < blockSize; i++) {
+            unsigned char c = raw[pos + i];
+            z.push_back(c);
+            a = (a + c) % 65521;
+            b = (b + a) % 65521;
+        }
+        pos += blockSize;
+    } while (pos < raw.size());
+    pngPutU32(z, (b << 16) | a);
+    pngChunk(file, "IDAT", z);
+
+    pngChunk(file, "IEND", std::vector<unsigned char>());
+    return true;
+}
+
+// ================= RUN =================
+
+// circles the scene, one full turn over the run
+inline glm::mat4 scriptedCameraView(const glm::vec3& center, float radius, int frame, int frames)
+{
+    float angle = glm::two_pi<float>() * (float)frame / (float)std::max(frames, 1);
+    float distance = std::max(radius, 1.0f) * 1.2f;
+    glm::vec3 eye = center + glm::vec3(cos(angle) * distance, distance * 0.35f, sin(angle) * distance);
+    return glm::lookAt(eye, center, glm::vec3(0.0f, 1.0f, 0.0f));
+}
+
+// per frame CPU/GPU timings into a CSV, summary at the end
+class HeadlessRun
+{
+public:
+    bool begin(const HeadlessOptions& opts)
+    {
+        options = opts;
+        csv.open(options.timingsPath);
+        if (!csv.is_open()) {
+            std::cout << "ERROR::HEADLESS:: can't write " << options.timingsPath << std::endl;
+            return false;
+        }
+        csv << "frame,cpu_ms,gpu_ms,meshes_drawn,meshes_culled\n";
+        glGenQueries(2, queries);
+        cpuTimes.reserve(options.frames);
+        gpuTimes.reserve(options.frames);
+        return true;
+    }
+
+    // endFrame() writes a PNG for this frame
+    bool captures(int frame) const
+    {
+        return !options.captureDir.empty() && options.captureEvery > 0 && frame % options.captureEvery == 0;
+    }
+
+    void beginFrame()
+    {
+        frameStart = std::chrono::steady_clock::now();
+        // timestamps, not GL_TIME_ELAPSED: the profiler's GPU scopes use that and elapsed queries don't nest
+        glQueryCounter(queries[0], GL_TIMESTAMP);
+    }
+
+    // waits for the GPU so both numbers belong to this frame
+    void endFrame(int frame, unsigned int drawn, unsigned int culled, const OffscreenTarget& target)
+    {
+        glQueryCounter(queries[1], GL_TIMESTAMP);
+        glFinish();
+        double cpuMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count();
+        GLuint64 gpuStart = 0, gpuStop = 0;
+        glGetQueryObjectui64v(queries[0], GL_QUERY_RESULT, &gpuStart);
+        glGetQueryObjectui64v(queries[1], GL_QUERY_RESULT, &gpuStop);
+        GLuint64 gpuNs = gpuStop - gpuStart;
+        double gpuMs = gpuNs / 1e6;
+
+        cpuTimes.push_back(cpuMs);
+        gpuTimes.push_back(gpuMs);
+        csv << frame << "," << cpuMs << "," << gpuMs << "," << drawn << "," << culled << "\n";
+
+        if (captures(frame)) {
+            target.readPixels(pixels);
+            char name[64];
+            snprintf(name, sizeof(name), "/frame_%05d.png", frame);
+            if (!writePNG(options.captureDir + name, target.width, target.height, pixels))
+                std::cout << "ERROR::HEADLESS:: can't write " << options.captureDir + name << std::endl;
+        }
+    }
+
+    void finish()
+    {
+        glDeleteQueries(2, queries);
+        csv.close();
+        std::cout << "Headless run: " << cpuTimes.size() << " frames at " << options.width << "x" << options.height
+                  << " | CPU " << summary(cpuTimes) << " | GPU " << summary(gpuTimes)
+                  << " | timings in " << options.timingsPath << "\n";
+    }
+
+private:
+    HeadlessOptions options;
+    std::ofstream csv;
+    unsigned int queries[2] = {};       // frame start / end timestamps
+    std::chrono::steady_clock::time_point frameStart;
+    std::vector<double> cpuTimes;
+    std::vector<double> gpuTimes;
+    std::vector<unsigned char> pixels;
+
+    static std::string summary(std::vector<double> values)
+    {
+        if (values.empty()) return "-";
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double v : values) sum += v;
+        char text[128];
+        snprintf(text, sizeof(text), "avg %.3f ms, p50 %.3f, p95 %.3f, max %.3f",
+            sum / values.size(), values[values.size() / 2], values[(size_t)(values.size() * 0.95)], values.back());
+        return text;
+    }
+};
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef INDIRECT_H
+#define INDIRECT_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+
+#include "model.hpp"
+#include "shader.hpp"
+#include "materials.hpp"
+#include "profiler.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <vector>
+
+// layout fixed by GL for glMultiDrawElementsIndirect
+struct DrawElementsIndirectCommand {
+    GLuint count;
+    GLuint instanceCount;
+    GLuint firstIndex;
+    GLint  baseVertex;
+    GLuint baseInstance;
+};
+
+// one per draw, matches DrawData (std430) in indirect.vert
+struct PerDrawData {
+    glm::mat4 model;
+    glm::vec4 tint;
+    GLuint material[4];     // [0] = texture array layer, rest is padding
+};
+
+// GPU driven submission: every registered model lives in one shared vertex/index buffer, per draw data
+// goes into a persistently mapped, triple buffered SSBO and the frame is issued as one
+// glMultiDrawElementsIndirect per texture array. Diffuse textures are layers of a few arrays
+// (materials.hpp) and every draw carries its layer, so riders, belts, seats and props with different
+// textures batch together. Needs GL 4.6 (or 4.4 + shader_draw_parameters).
+class IndirectRenderer
+{
+public:
+    static const unsigned int frameCount = 3;
+
+    unsigned int drawCount = 0;     // draws in the last flush
+    unsigned int batchCount = 0;    // glMultiDrawElementsIndirect calls in the last flush
+
+    static bool supported()
+    {
+        return (GLEW_VERSION_4_6 || (GLEW_VERSION_4_4 && GLEW_ARB_shader_draw_parameters))
+            && GLEW_ARB_multi_draw_indirect && GLEW_ARB_buffer_storage && GLEW_ARB_shader_storage_buffer_object;
+    }
+
+    ~IndirectRenderer()
+    {
+        release();
+    }
+
+    // frees the GL objects, has to run while the context is still alive
+    void release()
+    {
+        if (!built) return;
+        built = false;
+        for (unsigned int i = 0; i < frameCount; i++)
+            if (fences[i]) glDeleteSync(fences[i]);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+        glUnmapBuffer(GL_SHADER_STORAGE_BUFFER);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glUnmapBuffer(GL_DRAW_INDIRECT_BUFFER);
+        GLuint buffers[] = { VBO, EBO, drawBuffer, commandBuffer };
+        glDeleteBuffers(4, buffers);
+        glDeleteVertexArrays(1, &VAO);
+        materials.release();
+    }
+
+    // shared geometry plus the mapped per frame buffers, and the texture arrays (memstats.hpp)
+    size_t bufferBytes() const { return geometryBytes + (size_t)(drawRegionBytes + commandRegionBytes) * frameCount; }
+    size_t textureBytes() const { return materials.textureBytes(); }
+
+    // appends all meshes of the model to the shared buffers, call for every model before build()
+    void addModel(Model& model)
+    {
+        for (Mesh& mesh : model.meshes) {
+            mesh.firstIndex = (unsigned int)poolIndices.size();
+            mesh.baseVertex = (unsigned int)poolVertices.size();
+            poolVertices.insert(poolVertices.end(), mesh.vertices.begin(), mesh.vertices.end());
+            poolIndices.insert(poolIndices.end(), mesh.indices.begin(), mesh.indices.end());
+            mesh.material = materials.add(diffuseTexture(mesh));
+        }
+    }
+
+    // uploads the shared geometry and creates the mapped per frame buffers
+    void build(unsigned int maxDrawsPerFrame = 4096)
+    {
+        maxDraws = maxDrawsPerFrame;
+        materials.build();
+
+        glGenVertexArrays(1, &VAO);
+        glGenBuffers(1, &VBO);
+        glGenBuffers(1, &EBO);
+
+        glBindVertexArray(VAO);
+        glBindBuffer(GL_ARRAY_BUFFER, VBO);
+        glBufferStorage(GL_ARRAY_BUFFER, poolVertices.size() * sizeof(Vertex), poolVertices.data(), 0);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glBufferStorage(GL_ELEMENT_ARRAY_BUFFER, poolIndices.size() * sizeof(unsigned int), poolIndices.data(), 0);
+
+        // same layout as Mesh::setupMesh
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)0);
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, Normal));
+        glEnableVertexAttribArray(2);
+        glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+        glBindVertexArray(0);
+
+        geometryBytes = poolVertices.size() * sizeof(Vertex) + poolIndices.size() * sizeof(unsigned int);
+
+        // the CPU copy isn't needed any more
+        vector<Vertex>().swap(poolVertices);
+        vector<unsigned int>().swap(poolIndices);
+
+        // each frame gets its own region, bound with glBindBufferRange so it has to respect the offset alignment
+        GLint alignment = 256;
+        glGetIntegerv(GL_SHADER_STORAGE_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        drawRegionBytes = alignUp(maxDraws * sizeof(PerDrawData), (GLsizeiptr)alignment);
+        commandRegionBytes = maxDraws * sizeof(DrawElementsIndirectCommand);
+
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+
+        glGenBuffers(1, &drawBuffer);
+        glBindBuffer(GL_SHADER_STORAGE_BUFFER, drawBuffer);
+        glBufferStorage(GL_SHADER_STORAGE_BUFFER, drawRegionBytes * frameCount, NULL, flags);
+        mappedDraws = (char*)glMapBufferRange(GL_SHADER_STORAGE_BUFFER, 0, drawRegionBytes * frameCount, flags);
+
+        glGenBuffers(1, &commandBuffer);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferStorage(GL_DRAW_INDIRECT_BUFFER, commandRegionBytes * frameCount, NULL, flags);
+        mappedCommands = (char*)glMapBufferRange(GL_DRAW_INDIRECT_BUFFER, 0, commandRegionBytes * frameCount, flags);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+
+        items.reserve(maxDraws);
+        built = mappedDraws && mappedCommands;
+        if (!built) std::cout << "ERROR::INDIRECT:: couldn't map the per draw buffers" << std::endl;
+    }
+
+    bool ready() const { return built; }
+
+    // waits until the GPU is done with the region we are about to overwrite (written 3 frames ago)
+    void beginFrame()
+    {
+        PROFILE_SCOPE("indirect wait");
+        items.clear();
+        if (fences[region]) {
+            GLenum result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+            while (result == GL_TIMEOUT_EXPIRED)
+                result = glClientWaitSync(fences[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+            glDeleteSync(fences[region]);
+            fences[region] = 0;
+        }
+    }
+
+    // queues every visible mesh of the model. 'visible' comes from Model::cull, NULL draws all meshes.
+    void submit(const Model& model, const glm::mat4& matrix, const glm::vec3& tint, const unsigned char* visible)
+    {
+        PerDrawData* draws = (PerDrawData*)(mappedDraws + region * drawRegionBytes);
+
+        for (unsigned int i = 0; i < model.meshes.size(); i++) {
+            if (visible && !visible[i]) continue;
+            if (items.size() >= maxDraws) {
+                if (!overflowReported) std::cout << "WARNING::INDIRECT:: more than " << maxDraws << " draws in a frame, the rest is dropped" << std::endl;
+                overflowReported = true;
+                return;
+            }
+
+            const Mesh& mesh = model.meshes[i];
+            GLuint texture = materials.arrayOf(mesh.material);
+            unsigned int drawIndex = (unsigned int)items.size();
+
+            // per draw data goes straight into mapped memory, only the commands are sorted later
+            PerDrawData& data = draws[drawIndex];
+            data.model = matrix;
+            data.tint = glm::vec4(tint, 1.0f);
+            data.material[0] = materials.layerOf(mesh.material);
+
+            DrawItem item;
+            item.texture = texture;
+            item.command.count = mesh.indexCount;
+            item.command.instanceCount = 1;
+            item.command.firstIndex = mesh.firstIndex;
+            item.command.baseVertex = (GLint)mesh.baseVertex;
+            item.command.baseInstance = drawIndex;
+            items.push_back(item);
+        }
+    }
+
+    // writes the commands grouped by texture array and issues one multi draw per group
+    void flush(Shader& shader)
+    {
+        PROFILE_SCOPE("indirect flush");
+        drawCount = (unsigned int)items.size();
+        batchCount = 0;
+
+        if (!items.empty()) {
+            std::sort(items.begin(), items.end(), [](const DrawItem& a, const DrawItem& b) { return a.texture < b.texture; });
+
+            DrawElementsIndirectCommand* commands = (DrawElementsIndirectCommand*)(mappedCommands + region * commandRegionBytes);
+            for (unsigned int i = 0; i < items.size(); i++)
+                commands[i] = items[i].command;
+
+            shader.use();
+            glActiveTexture(GL_TEXTURE0);
+            glUniform1i(glGetUniformLocation(shader.ID, "uDiffArray"), 0);
+
+            glBindVertexArray(VAO);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+            glBindBufferRange(GL_SHADER_STORAGE_BUFFER, 0, drawBuffer, region * drawRegionBytes, drawRegionBytes);
+
+            unsigned int first = 0;
+            while (first < items.size()) {
+                unsigned int last = first;
+                while (last < items.size() && items[last].texture == items[first].texture) last++;
+
+                glBindTexture(GL_TEXTURE_2D_ARRAY, items[first].texture);
+                glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT,
+                    (const void*)(region * commandRegionBytes + first * sizeof(DrawElementsIndirectCommand)),
+                    (GLsizei)(last - first), 0);
+                batchCount++;
+                first = last;
+            }
+
+            glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+            glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+            glBindVertexArray(0);
+        }
+
+        fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        region = (region + 1) % frameCount;
+    }
+
+private:
+    struct DrawItem {
+        GLuint texture;         // texture array
+        DrawElementsIndirectCommand command;
+    };
+
+    bool built = false;
+    bool overflowReported = false;
+    unsigned int maxDraws = 0;
+
+    vector<Vertex> poolVertices;
+    size_t geometryBytes = 0;
+    vector<unsigned int> poolIndices;
+    GLuint VAO = 0, VBO = 0, EBO = 0;
+
+    GLuint drawBuffer = 0, commandBuffer = 0;
+    char* mappedDraws = nullptr;
+    char* mappedCommands = nullptr;
+    GLsizeiptr drawRegionBytes = 0;
+    GLsizeiptr commandRegionBytes = 0;
+    GLsync fences[frameCount] = {};
+    unsigned int region = 0;
+
+    vector<DrawItem> items;
+    MaterialArrays materials;
+
+    static GLsizeiptr alignUp(GLsizeiptr value, GLsizeiptr alignment)
+    {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    // Mesh::Draw binds the first diffuse map as uDiffMap1, that one becomes the mesh's layer
+    static GLuint diffuseTexture(const Mesh& mesh)
+    {
+        for (const Texture& texture : mesh.textures)
+            if (texture.type == "uDiffMap") return texture.id;
+        return 0;
+    }
+};
+
+#endif
@@ -0,0 +1,37 @@
+#version 460 core
+layout (location = 0) in vec3 inPos;
+layout (location = 1) in vec3 inNormal;
+layout (location = 2) in vec2 inUV;
+
+// one entry per draw, written by IndirectRenderer (indirect.hpp), indexed by the command's baseInstance
+struct DrawData {
+    mat4 model;
+    vec4 tint;
+    uvec4 material;     // x = layer in the texture array (materials.hpp)
+};
+
+layout (std430, binding = 0) readonly buffer DrawBlock {
+    DrawData draws[];
+};
+
+out vec3 chFragPos;
+out vec3 chNormal;
+out vec2 chUV;
+flat out vec3 chTint;
+flat out uint chLayer;
+
+uniform mat4 uV;
+uniform mat4 uP;
+
+void main()
+{
+    mat4 model = draws[gl_BaseInstance].model;
+
+    chUV = inUV;
+    chTint = draws[gl_BaseInstance].tint.rgb;
+    chLayer = draws[gl_BaseInstance].material.x;
+    chFragPos = vec3(model * vec4(inPos, 1.0));
+    chNormal = mat3(transpose(inverse(model))) * inNormal;
+
+    gl_Position = uP * uV * vec4(chFragPos, 1.0);
+}
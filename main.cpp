@@ -17,15 +17,31 @@
 
 #include "shader.hpp"
 #include "model.hpp"
+#include "frustum.hpp"
+#include "pacer.hpp"
+#include "profiler.hpp"
+#include "indirect.hpp"
+#include "headless.hpp"
+#include "replay.hpp"
+#include "track.hpp"
+#include "trains.hpp"
+#include "scene.hpp"
+#include "transform.hpp"
+#include "clustered.hpp"
+#include "shadows.hpp"
+#include "deferred.hpp"
+#include "prepass.hpp"
+#include "riders.hpp"
+#include "guestflow.hpp"
+#include "seating.hpp"
+#include "comfort.hpp"
+#include "streaming.hpp"
+#include "memstats.hpp"
+#include "arena.hpp"
 
 // ================= GLOBAL VARIABLES =================
 
-float carSpeed = 0.01f;
-std::vector<glm::vec3> rawVertices;     //vertexi iz obj fajla
-std::vector<glm::vec3> keyPoints;       //centroidi
-std::vector<glm::vec3> sortedPoints;    //po ovome se auto krece
-
-glm::vec3 carPosition(1.0f);                //trenutno pozicija
+glm::vec3 carPosition(1.0f);                //trenutno pozicija (voz sa putnicima)
 glm::vec3 carFront(0.0f, 0.0f, 1.0f);       //pravac kretanja
 
 glm::vec3 seatsOffset(0.0f, 0.3f, 0.0f);    
@@ -38,73 +54,430 @@ float lastY = 720.0f / 2.0f;
 bool firstMouse = true;
 
 
-//stanja auta
-enum CarState { MOVING, SLOWING_DOWN, RETURNING, STOPPED, WAITING };
-CarState carState = STOPPED;
+//park: staze, vozovi i rekviziti (--scene fajl, inace samo res/tracks.obj)
+Scene park;
+std::string scenePath;
+bool proceduralTrack = false;       // --procedural-track: res/coaster.track umesto res/tracks.obj
+std::string exportTrackPath;        // --export-track: kontrolne tacke iz res/tracks.obj, pa izlaz
+std::vector<unsigned int> visibleObjects;   // rezultat octree upita, ne alocira se svaki frejm
+std::vector<unsigned int> nearbyObjects;
 
+//voz 0 na prvoj stazi je onaj sa putnicima (stanje, brzina, t su u trains.hpp)
+const unsigned int riderTrain = 0;
+unsigned int trainCount = 1;        // --trains
+unsigned int blockCount = 0;        // --blocks, 0 = 3 po vozu (najmanje 16)
 
-//promenljive za kretanje
-float t = 0.0f;        // parametar napredovanja 
-float waitTimer = 0.0f;
-float minSpeed = 0.05f;
-float maxSpeed = 0.50f;
-float gravityFactor = 9.7f;
+TrainManager& riderTrains() {
+    return park.tracks[0].trains;
+}
 
 //flagovi 
 bool allowBoarding = true;
-const int maxSeats = 8;
-
-
-struct Passenger {
-    float offsetX, offsetY, offsetZ;
-    bool beltOn;
-    bool isSick;
-    bool active;            
-    int index; //for model
+const unsigned int seatKeys = 8;    // tasteri 1-8, kod duzih vozova taster k vazi za sedista k, k+8, k+16...
+
+//raspored sedista i modeli putnika iz tabele (seating.hpp), --seating / --car
+std::string seatingPath = "res/seating.table";
+std::string carType;
+SeatingTable seating;
+const CarLayout* carLayout = nullptr;
+
+// hijerarhija transformacija: voz -> auto/sedista, okvir putnika -> sediste -> putnik/pojas/kamera.
+// Svetske matrice se racunaju samo za podstabla koja su se promenila (transform.hpp).
+TransformHierarchy transforms;
+
+struct TrainRig {
+    unsigned int track, train;
+    int base, car, seats;       // base = pozicija auta na stazi
+    float lastT;                // t za koji je base poslednji put postavljen
 };
+std::vector<TrainRig> trainRigs;
 
-struct PassengerModelData {
-    float scale;
-    glm::vec3 positionOffset;
+struct RiderRig {
+    int frame;                  // voz sa putnicima na stazi (bez pomeraja auta)
+    int seatFrame;              // okrenut za passengerRotation
+    std::vector<int> seat, rider, belt;     // po sedistu iz carLayout
+    int camera;                 // glava prvog putnika
 };
+RiderRig riderRig;
+bool riderSeatsChanged = true;
 
+const glm::vec3 carOffset(0.2f, 1.5f, 0.65f);
+const glm::vec3 beltOffset(-0.5f, 1.8f, 0.53f);
+const glm::vec3 headOffset(-1.0f, 0.8f + 1.5f, 0.0f);
 
-std::vector<PassengerModelData> modelData = {
-    {0.007f, glm::vec3(-0.5f, 1.5f, 0.33f)},   // mei
-    {0.17f,  glm::vec3(-0.9f, 1.8f, 0.33f)},   // old-lady
-    {0.2f, glm::vec3(-2.0f, 1.5f, 0.20f)},   // football-fan
-    {1.1f, glm::vec3(-1.0f, 1.8f, 0.20f)},  // person1
-    {1.2f, glm::vec3(-0.8f, 1.8f, 0.45f)},   // person2
-    {0.024f,  glm::vec3(-0.8f, 1.5f, 0.2f)},   // soldier
-    {1.0f, glm::vec3(-0.8f, 1.9f, 0.30f)},   // person3
-    {0.008f, glm::vec3(-0.8f, 1.5f, 0.45f)}    // doctor
-};
-
-std::vector<Passenger> passengers;
+//putnici voza sa putnicima: aktivni/pojas/muka su bitseti po sedistu (riders.hpp), velicina iz carLayout
+RiderSeats riders;
 int activeCameraPassenger = -1;
 
+//mapa udobnosti staze sa putnickim vozom, muka putnika se racuna iz nje (comfort.hpp). --comfort / K je crta na stazi
+ComfortMap comfortMap;
+SicknessModel sickness;
+bool comfortView = false;
+
+
+//modeli putnika se ucitavaju tek kad neko sedne, neiskorisceni se izbacuju preko budzeta (--rider-budget)
+ModelStreamer passengerModels;
+
+// koliko RAM/VRAM kostaju modeli: izvestaj na startu (--memory-report sa svakim meshom i teksturom) i na M.
+// --release-geometry brise CPU kopije vertexa/indeksa posle upload-a
+bool releaseGeometry = false;
+bool memoryReportDetail = false;
+bool memoryReportRequested = false;
 
-std::vector<Model> passengerModels;
+//privremeni podaci frejma idu u frameMemory (dva bafera koji se smenjuju, bez heap-a posle zagrevanja)
+FrameAllocator frameMemory;
+
+//putnici za crtanje u ovom frejmu, isti za senke, pre-pass i boju
+struct RiderDraw {
+    Model* model;               // nullptr dok se model ucitava, pojas se ipak crta
+    glm::mat4 rider, belt;
+    glm::vec3 tint;
+    bool belted;
+};
+RiderDraw* riderDraws = nullptr;
+unsigned int riderDrawCount = 0;
+
+// --check-allocs: posle zagrevanja frejm bez tastera i ucitavanja ne sme da alocira, izlaz -9 ako jeste
+bool checkAllocations = false;
+AllocationCheck allocationCheck;
+unsigned int frameKeyEvents = 0;
+
+// frustum culling, planes are rebuilt every frame from uP * uV
+bool frustumCullingEnabled = true;
+Frustum frustum;
+CullStats cullStats;
+
+// frame pacing, rate can be changed with --fps, 0 = unlimited
+double targetFrameRate = 75.0;
+bool vsyncEnabled = false;
+FramePacer framePacer;
+
+// --profile snima CPU/GPU vremena, P ili izlaz upisuje trace
+std::string profileOutput = "profile.json";
+
+// --mdi: cela scena ide kroz glMultiDrawElementsIndirect (treba GL 4.6), inace klasican put
+bool indirectRequested = false;
+IndirectRenderer* indirectRenderer = nullptr;
+
+// --lights N: N svetala duz staza, clustered forward (clustered.hpp), 0 = iskljuceno i dan
+unsigned int parkLightCount = 0;
+ClusteredLighting parkLights;
+
+// senke od sunca: staticki sloj (staze, rekviziti) se crta samo kad se svetlo promeni, vozovi svaki frejm
+// --no-shadows iskljucuje
+bool shadowsEnabled = true;
+ShadowMaps shadows;
+const glm::vec3 sunPosition(50.0f, 100.0f, 75.0f);
+
+// --deferred ili G: G-buffer + jedan full screen prolaz osvetljenja umesto osvetljenja po fragmentu
+bool deferredShading = false;
+GBuffer gbuffer;
+ShadingTimer shadingTimer;
+
+// --prepass ili Z: prvo samo dubina, pa boja sa GL_EQUAL (svaki piksel se osvetljava jednom)
+// O: prikaz overdraw-a, svetlije = vise fragmenata po pikselu
+bool depthPrepassEnabled = false;
+bool overdrawView = false;
+FragmentCounter fragmentCounter;
+const glm::vec4 skyColor(0.12f, 0.8f, 1.0f, 1.0f);
+
+// --guestflow N: simulacija reda na stanici za N gostiju (bez prozora), ispise vozace po satu i cekanje
+bool guestFlowRequested = false;
+GuestFlow guestFlow;
+
+// --headless: bez monitora, crta u FBO, kamera i voznja su skriptovani
+HeadlessOptions headless;
+
+// --record / --replay: snimanje ulaza i deltaTime-a za ponovljiva merenja
+std::string recordPath, replayPath;
+InputRecorder inputRecorder;
+InputReplay inputReplay;
+
+// ================= OPTIONS =================
+
+void parseOptions(int argc, char** argv) {
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--fps" && i + 1 < argc) {
+            targetFrameRate = atof(argv[++i]);
+        }
+        else if (arg == "--vsync") {
+            vsyncEnabled = true;
+        }
+        else if (arg == "--headless") {
+            headless.enabled = true;
+            int w, h;
+            if (i + 1 < argc && sscanf(argv[i + 1], "%dx%d", &w, &h) == 2) {
+                headless.width = w;
+                headless.height = h;
+                i++;
+            }
+        }
+        else if (arg == "--frames" && i + 1 < argc) {
+            headless.frames = atoi(argv[++i]);
+            headless.framesGiven = true;
+        }
+        else if (arg == "--timings" && i + 1 < argc) {
+            headless.timingsPath = argv[++i];
+        }
+        else if (arg == "--capture" && i + 1 < argc) {
+            headless.captureDir = argv[++i];
+        }
+        else if (arg == "--capture-every" && i + 1 < argc) {
+            headless.captureEvery = atoi(argv[++i]);
+        }
+        else if (arg == "--record" && i + 1 < argc) {
+            recordPath = argv[++i];
+        }
+        else if (arg == "--replay" && i + 1 < argc) {
+            replayPath = argv[++i];
+        }
+        else if (arg == "--replay-fast") {
+            inputReplay.fast = true;
+        }
+        else if (arg == "--no-shader-cache") {
+            Shader::cacheDirectory().clear();
+        }
+        else if (arg == "--scene" && i + 1 < argc) {
+            scenePath = argv[++i];
+        }
+        else if (arg == "--procedural-track") {
+            proceduralTrack = true;
+        }
+        else if (arg == "--export-track" && i + 1 < argc) {
+            exportTrackPath = argv[++i];
+        }
+        else if (arg == "--trains" && i + 1 < argc) {
+            trainCount = (unsigned int)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--blocks" && i + 1 < argc) {
+            blockCount = (unsigned int)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--lights" && i + 1 < argc) {
+            parkLightCount = (unsigned int)std::max(0, atoi(argv[++i]));
+        }
+        else if (arg == "--guestflow" && i + 1 < argc) {
+            guestFlowRequested = true;
+            guestFlow.params.guests = (unsigned int)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--arrival-rate" && i + 1 < argc) {
+            guestFlow.params.arrivalsPerHour = (float)std::max(1.0, atof(argv[++i]));
+        }
+        else if (arg == "--train-seats" && i + 1 < argc) {
+            guestFlow.params.seatsPerTrain = (unsigned int)std::max(1, atoi(argv[++i]));
+        }
+        else if (arg == "--seating" && i + 1 < argc) {
+            seatingPath = argv[++i];
+        }
+        else if (arg == "--car" && i + 1 < argc) {
+            carType = argv[++i];
+        }
+        else if (arg == "--check-allocs") {
+            checkAllocations = true;
+        }
+        else if (arg == "--release-geometry") {
+            releaseGeometry = true;
+        }
+        else if (arg == "--memory-report") {
+            memoryReportDetail = true;
+        }
+        else if (arg == "--comfort") {
+            comfortView = true;
+        }
+        else if (arg == "--sickness" && i + 1 < argc) {
+            sickness.tolerance = (float)std::max(0.1, atof(argv[++i]));
+        }
+        else if (arg == "--rider-budget" && i + 2 < argc) {
+            passengerModels.cpuBudget = (size_t)std::max(0.0, atof(argv[++i]) * 1024 * 1024);
+            passengerModels.gpuBudget = (size_t)std::max(0.0, atof(argv[++i]) * 1024 * 1024);
+        }
+        else if (arg == "--prepass") {
+            depthPrepassEnabled = true;
+        }
+        else if (arg == "--deferred") {
+            deferredShading = true;
+        }
+        else if (arg == "--no-shadows") {
+            shadowsEnabled = false;
+        }
+        else if (arg == "--mdi") {
+            indirectRequested = true;
+        }
+        else if (arg == "--profile") {
+            Profiler::get().setEnabled(true);
+            if (i + 1 < argc && argv[i + 1][0] != '-') profileOutput = argv[++i];
+        }
+        else {
+            std::cout << "Unknown option: " << arg << "\n";
+        }
+    }
+}
 
 // ================= HELPERS =================
 
-//cita iz obj fajla vertexe
-void loadTrackVertices(const std::string& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) return;
-    rawVertices.clear();
-    std::string line;
-    while (std::getline(file, line)) {
-        std::stringstream ss(line);
-        std::string prefix;
-        ss >> prefix;
-        if (prefix == "v") {
-            float x, y, z;
-            ss >> x >> y >> z;
-            rawVertices.push_back(glm::vec3(x, y, z));
-        }
-    }
-    file.close();
+//pravi cvorove za sve vozove u parku, putnicki voz dobija i sedista, putnike, pojaseve i kameru
+void buildTrainRigs(const glm::mat4& passengerRotation) {
+    transforms.clear();
+    trainRigs.clear();
+
+    for (unsigned int k = 0; k < park.tracks.size(); k++) {
+        for (unsigned int i = 0; i < park.tracks[k].trains.count(); i++) {
+            TrainRig rig;
+            rig.track = k;
+            rig.train = i;
+            rig.base = transforms.add(-1);
+            rig.car = transforms.add(rig.base, glm::scale(glm::mat4(1.0f), glm::vec3(0.8f)));
+            rig.seats = transforms.add(rig.base, glm::scale(glm::translate(glm::mat4(1.0f), seatsOffset), glm::vec3(0.8f)));
+            rig.lastT = -1.0f;
+            trainRigs.push_back(rig);
+        }
+    }
+
+    riderRig.frame = transforms.add(-1);
+    riderRig.seatFrame = transforms.add(riderRig.frame, passengerRotation);
+    unsigned int seatCount = carLayout->seats();
+    riderRig.seat.resize(seatCount);
+    riderRig.rider.resize(seatCount);
+    riderRig.belt.resize(seatCount);
+    for (unsigned int i = 0; i < seatCount; i++) {
+        riderRig.seat[i] = transforms.add(riderRig.seatFrame, carLayout->seatTransforms[i]);
+        riderRig.rider[i] = transforms.add(riderRig.seat[i]);
+        glm::mat4 belt = glm::translate(glm::mat4(1.0f), beltOffset);
+        riderRig.belt[i] = transforms.add(riderRig.seat[i], glm::rotate(belt, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+    }
+    riderRig.camera = transforms.add(riderRig.seat[0], glm::translate(glm::mat4(1.0f), headOffset));
+}
+
+//svetla ravnomerno duz svih staza, malo iznad sina
+void placeParkLights(unsigned int count) {
+    const glm::vec3 palette[] = {
+        glm::vec3(1.0f, 0.75f, 0.4f), glm::vec3(1.0f, 0.3f, 0.2f), glm::vec3(0.3f, 0.6f, 1.0f),
+        glm::vec3(0.4f, 1.0f, 0.5f), glm::vec3(1.0f, 0.4f, 0.9f)
+    };
+    size_t totalPoints = 0;
+    for (const SceneTrack& track : park.tracks) totalPoints += track.path.size();
+
+    parkLights.lights.clear();
+    for (const SceneTrack& track : park.tracks) {
+        if (track.path.empty() || totalPoints == 0) continue;
+        unsigned int n = std::max(1u, (unsigned int)(count * track.path.size() / totalPoints));
+        for (unsigned int i = 0; i < n && parkLights.lights.size() < count; i++) {
+            PointLight light;
+            light.position = track.path[i * track.path.size() / n] + glm::vec3(0.0f, 2.5f, 0.0f);
+            light.radius = 6.0f;
+            light.color = 4.0f * palette[parkLights.lights.size() % 5];
+            parkLights.lights.push_back(light);
+        }
+    }
+}
+
+//postavlja lokalne matrice vozova koji su se pomerili i racuna svetske
+void updateTrainTransforms() {
+    PROFILE_SCOPE("transforms");
+    for (TrainRig& rig : trainRigs) {
+        const TrainManager& trains = park.tracks[rig.track].trains;
+        if (trains.t[rig.train] == rig.lastT) continue;
+        rig.lastT = trains.t[rig.train];
+
+        glm::mat4 rotationMatrix = carRotationMatrix(trains.front[rig.train]);
+        transforms.setLocal(rig.base, glm::translate(glm::mat4(1.0f), trains.position[rig.train] + carOffset) * rotationMatrix);
+        if (rig.track == 0 && rig.train == riderTrain) {
+            transforms.setLocal(riderRig.frame, glm::translate(glm::mat4(1.0f), trains.position[rig.train]) * rotationMatrix);
+            riderSeatsChanged = true;
+        }
+    }
+
+    // modeli putnika se jos jednom okrecu za orijentaciju auta, pa zavise od pozicije na stazi
+    if (riderSeatsChanged) {
+        glm::mat4 rotationMatrix = carRotationMatrix(riderTrains().front[riderTrain]);
+        for (unsigned int seat : riders.active()) {
+            transforms.setLocal(riderRig.rider[seat], rotationMatrix * seating.riders[riders.model[seat]].fit);
+        }
+        riderSeatsChanged = false;
+    }
+
+    transforms.update();
+}
+
+//crta model, preskace meshove van frustuma
+void drawModel(Model& model, Shader& shader, const glm::mat4& modelMatrix, const glm::vec3& tint = glm::vec3(1.0f)) {
+    if (indirectRenderer) {
+        const unsigned char* visible = nullptr;
+        if (frustumCullingEnabled) visible = model.cull(frustum, modelMatrix, cullStats);
+        else cullStats.drawn += (unsigned int)model.meshes.size();
+        indirectRenderer->submit(model, modelMatrix, tint, visible);
+        return;
+    }
+
+    shader.setMat4("uM", modelMatrix);
+    if (frustumCullingEnabled) {
+        model.Draw(shader, frustum, modelMatrix, cullStats);
+    }
+    else {
+        model.Draw(shader);
+        cullStats.drawn += (unsigned int)model.meshes.size();
+    }
+}
+
+//samo dubina, za shadow mape
+void drawShadowCaster(Model& model, Shader& shadowShader, const glm::mat4& modelMatrix) {
+    shadowShader.setMat4("uM", modelMatrix);
+    model.DrawDepth();
+}
+
+//sfera oko modela (xyz centar, w poluprecnik), za senke vozova
+glm::vec4 casterSphere(const Model& model, const glm::mat4& modelMatrix) {
+    glm::vec3 center = glm::vec3(modelMatrix * glm::vec4(model.bounds.center, 1.0f));
+    return glm::vec4(center, model.bounds.radius * maxAxisScale(modelMatrix));
+}
+
+//depth pre-pass, isti meshovi kao drawModel (statistika se broji tek u prolazu boje)
+void drawModelDepth(Model& model, Shader& depthShader, const glm::mat4& modelMatrix) {
+    depthShader.setMat4("uM", modelMatrix);
+    if (frustumCullingEnabled) {
+        CullStats ignored;
+        model.DrawDepth(model.cull(frustum, modelMatrix, ignored));
+    }
+    else {
+        model.DrawDepth();
+    }
+}
+
+// matrice i boja svakog putnika jednom po frejmu, u frameMemory
+void buildRiderDraws() {
+    const std::vector<unsigned int>& active = riders.active();
+    riderDraws = frameMemory.allocate<RiderDraw>(active.size());
+    riderDrawCount = (unsigned int)active.size();
+    for (unsigned int i = 0; i < riderDrawCount; i++) {
+        unsigned int seat = active[i];
+        RiderDraw& draw = riderDraws[i];
+        draw.model = passengerModels.get(riders.model[seat]);
+        draw.rider = transforms.world(riderRig.rider[seat]);
+        draw.belted = riders.isBelted(seat);
+        draw.belt = transforms.world(riderRig.belt[seat]);
+        draw.tint = riders.isSick(seat) ? glm::vec3(0.2f, 1.0f, 0.2f) : glm::vec3(1.0f, 1.0f, 1.0f);
+    }
+}
+
+void reportMemory(std::ostream& out, Model& car, Model& seats, Model& belt, bool detail) {
+    MemoryReport memory;
+    park.report(memory);
+    memory.add("car", car);
+    memory.add("seats", seats);
+    memory.add("belt", belt);
+    passengerModels.report(memory);
+    if (indirectRenderer) memory.addGpu("indirect pool", indirectRenderer->bufferBytes(), indirectRenderer->textureBytes());
+    memory.print(out, detail);
+}
+
+void setLightUniforms(Shader& shader) {
+    // sa svetlima parka je noc, sunce postaje mesec
+    float sun = parkLightCount > 0 ? 0.08f : 1.0f;
+    shader.setVec3("uLightPos1", sunPosition);
+    shader.setVec3("uLightColor1", 2 * sun, 2 * sun, 2.5f * sun);
+    shader.setVec3("uLightPos2", -50, 0, 0);
+    shader.setVec3("uLightColor2", 0.5f * sun, 0.5f * sun, 0.5f * sun);
+    shader.setVec3("uViewPos", 0, 0, 5);
 }
 
 void setupGreenFilter(unsigned int& VAO, unsigned int& VBO)
@@ -135,6 +508,35 @@ void setupGreenFilter(unsigned int& VAO, unsigned int& VBO)
     glBindVertexArray(0);
 }
 
+//linija iznad staze obojena po udobnosti segmenta, pozicija + boja po tacki
+unsigned int setupComfortOverlay(unsigned int& VAO, unsigned int& VBO, const std::vector<glm::vec3>& path, const ComfortMap& map)
+{
+    std::vector<float> vertices;
+    vertices.reserve(path.size() * 6);
+    for (unsigned int k = 0; k < map.segments(); k++) {
+        glm::vec3 p = path[k] + glm::vec3(0.0f, 0.3f, 0.0f);
+        glm::vec3 c = map.color(k);
+        vertices.insert(vertices.end(), { p.x, p.y, p.z, c.x, c.y, c.z });
+    }
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+
+    glBindVertexArray(VAO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    if (!vertices.empty()) glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(float), &vertices[0], GL_STATIC_DRAW);
+
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void*)(3 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+    glBindVertexArray(0);
+    return map.segments();
+}
+
 unsigned int createGreenFilter()
 {
     unsigned int greenTextureID;
@@ -151,79 +553,11 @@ unsigned int createGreenFilter()
 }
 
 
-//kreira centoride, pravi zatvrorenu putanju
-void generateKeyPoints() {
-    keyPoints.clear();
-    const int verticesPerPart = 382;
-    int maxVertices = rawVertices.size();
-
-    for (int i = 0; i < maxVertices; i += verticesPerPart) {
-        glm::vec3 sum(0.0f);
-        int count = 0;
-        for (int j = 0; j < verticesPerPart && (i + j) < maxVertices; ++j) {
-            sum += rawVertices[i + j];
-            count++;
-        }
-        if (count > 0) keyPoints.push_back(sum / (float)count);
-    }
-
-    if (keyPoints.empty()) return;
-
-    sortedPoints.clear();
-    std::vector<bool> visited(keyPoints.size(), false);
-
-    glm::vec3 current = keyPoints[0];
-    sortedPoints.push_back(current);
-    visited[0] = true;
-
-    for (size_t i = 1; i < keyPoints.size(); ++i) {
-        float minDist = 1000000.0f;
-        int nextIdx = -1;
-
-        for (size_t j = 0; j < keyPoints.size(); ++j) {
-            if (!visited[j]) {
-                float d = glm::distance(current, keyPoints[j]);
-                if (d < minDist) {
-                    minDist = d;
-                    nextIdx = (int)j;
-                }
-            }
-        }
-
-        if (nextIdx != -1) {
-            visited[nextIdx] = true;
-            current = keyPoints[nextIdx];
-            sortedPoints.push_back(current);
-        }
-    }
-    std::cout << "Sorted " << sortedPoints.size() << " points for a continuous loop.\n";
-}
-
-bool allGone() {
-    bool gone = true;
-    for (Passenger& p : passengers) {
-        if (p.active) {
-            gone = false;
-            break;
-        }
-    }
-    return gone;
-}
-
 void startRide(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
-    bool allBelts = true;
-    
-    if (key == GLFW_KEY_ENTER && action == GLFW_PRESS && carState == STOPPED && !passengers.empty()) {
-        for (Passenger& p : passengers) {
-            if (!p.beltOn) {
-                allBelts = false;
-                break;
-            }
-        }
-
-        if (allBelts) {
-            carState = MOVING;
+    if (key == GLFW_KEY_ENTER && action == GLFW_PRESS && riderTrains().state[riderTrain] == STOPPED && !riders.allGone()) {
+        if (riders.allBelted()) {
+            riderTrains().state[riderTrain] = MOVING;
             allowBoarding = false;
         }
     }
@@ -231,35 +565,21 @@ void startRide(GLFWwindow* window, int key, int scancode, int action, int mods)
 
 void addPassanger(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
-    if (action == GLFW_PRESS && carState != MOVING && allowBoarding) {
+    if (action == GLFW_PRESS && riderTrains().state[riderTrain] != MOVING && allowBoarding) {
         if (key == GLFW_KEY_SPACE) {
 
-            if (passengers.size() >= maxSeats) return;
-            int seatIndex = passengers.size();
-
-            int row = seatIndex % 2;
-            int col = seatIndex / 2;
+            unsigned int seatIndex = riders.freeSeat();
+            if (seatIndex >= riders.seats()) return;
 
             if (seatIndex == 0) {
                 activeCameraPassenger = 0;
             }
 
-            float horizontalSpacing = 1.1f;  // razmak između kolona
-            float verticalSpacing = 1.2f;  // razmak između redova
-            float seatHeight = 0.0f;
-
-            Passenger p;
-
-            p.offsetX = -1.5 + col * horizontalSpacing;  //levo-desno
-            p.offsetY = seatHeight;                        //visina
-            p.offsetZ = -0.6f + row * verticalSpacing;    //napred-nazad
-
-            p.beltOn = false;
-            p.isSick = false;
-            p.active = true;
-            p.index = seatIndex;
-
-            passengers.push_back(p);
+            // mesto i model su iz tabele, cvor sedista je vec postavljen u buildTrainRigs
+            riders.board(seatIndex, seating.riderFor(seatIndex), carLayout->seatOffsets[seatIndex]);
+            passengerModels.request(seating.riderFor(seatIndex));
+            sickness.board(seatIndex);
+            riderSeatsChanged = true;
 
         }
     }
@@ -267,69 +587,43 @@ void addPassanger(GLFWwindow* window, int key, int scancode, int action, int mod
 
 void removePassenger(GLFWwindow* window, int key, int scancode, int action, int mods) {
     
-    if (action == GLFW_PRESS && carState == STOPPED && !allowBoarding) {
+    if (action == GLFW_PRESS && riderTrains().state[riderTrain] == STOPPED && !allowBoarding) {
         if (key >= GLFW_KEY_1 && key <= GLFW_KEY_8) {
             int index = key - GLFW_KEY_1;
             if (key == GLFW_KEY_1) {
                 activeCameraPassenger = -1;
             }
-            if (index < passengers.size() && passengers[index].active) {
-                passengers[index].active = false;
-                passengers[index].isSick = false;
-            }
+            for (unsigned int seat = index; seat < riders.seats(); seat += seatKeys)
+                if (riders.isActive(seat)) riders.leave(seat);
         }
     }
 
-    if (allGone()) {
-        passengers.clear();
+    if (riders.allGone()) {
+        riders.clear();
         allowBoarding = true;
     }
 }
 
 void makePassengerSick(int index) {
-    if (passengers.size() > index) {      
-        passengers[index].isSick = true;
-        carState = SLOWING_DOWN;
-    }
-}
-
-void sickPassenger(GLFWwindow* window, int key, int scancode, int action, int mods) {
-
-    if (action == GLFW_PRESS && carState == MOVING) {
-        if (key >= GLFW_KEY_1 && key <= GLFW_KEY_8) {
-            int index = key - GLFW_KEY_1;
-            makePassengerSick(index);
-        }
+    if (riders.isActive(index)) {
+        riders.makeSick(index);
+        riderTrains().state[riderTrain] = SLOWING_DOWN;
     }
 }
 
 void putBeltOn(GLFWwindow* window, int key, int scancode, int action, int mods) {
 
-    if (action == GLFW_PRESS && carState == STOPPED && allowBoarding) {
+    if (action == GLFW_PRESS && riderTrains().state[riderTrain] == STOPPED && allowBoarding) {
         if (key >= GLFW_KEY_1 && key <= GLFW_KEY_8) {
             int index = key - GLFW_KEY_1;
-            if (index < passengers.size() && passengers[index].active) {
-                passengers[index].beltOn = true;
-            }
+            for (unsigned int seat = index; seat < riders.seats(); seat += seatKeys)
+                if (riders.isActive(seat)) riders.buckle(seat);
         }
     }
 }
 
 void stopCar() {
-    for (Passenger& p : passengers) {
-        p.beltOn = false;
-    }
-}
-
-std::pair<glm::vec3, glm::vec3> getCarPosition(const std::vector<glm::vec3>& points, float t) {
-    int n = points.size();
-    int i0 = (int)(t * n);
-    int i1 = (i0 + 1) % n;
-    float alpha = t * n - i0;
-
-    glm::vec3 pos = glm::mix(points[i0], points[i1], alpha);
-    glm::vec3 forward = glm::normalize(points[i1] - points[i0]);
-    return { pos, forward };
+    riders.unbuckleAll();
 }
 
 void mouse_callback(GLFWwindow* window, double xposIn, double yposIn) {
@@ -390,34 +684,151 @@ void toggleRenderSettings(GLFWwindow* window, int key, int scancode, int action,
                 std::cout << "Face Culling: OFF\n";
             }
         }
+
+        if (key == GLFW_KEY_C) {
+            frustumCullingEnabled = !frustumCullingEnabled;
+            std::cout << "Frustum Culling: " << (frustumCullingEnabled ? "ON" : "OFF") << "\n";
+        }
+
+        if (key == GLFW_KEY_V) {
+            framePacer.setVsync(!framePacer.getVsync());
+            std::cout << "VSync: " << (framePacer.getVsync() ? "ON" : "OFF") << "\n";
+        }
+
+        if (key == GLFW_KEY_G) {
+            deferredShading = !deferredShading;
+            std::cout << "Shading: " << (deferredShading ? "DEFERRED" : "FORWARD") << "\n";
+        }
+
+        if (key == GLFW_KEY_Z) {
+            depthPrepassEnabled = !depthPrepassEnabled;
+            std::cout << "Depth pre-pass: " << (depthPrepassEnabled ? "ON" : "OFF") << "\n";
+        }
+
+        if (key == GLFW_KEY_O) {
+            overdrawView = !overdrawView;
+            std::cout << "Overdraw view: " << (overdrawView ? "ON" : "OFF") << "\n";
+        }
+
+        if (key == GLFW_KEY_M) {
+            memoryReportRequested = true;
+        }
+
+        if (key == GLFW_KEY_K) {
+            comfortView = !comfortView;
+            std::cout << "Comfort map: " << (comfortView ? "ON" : "OFF") << "\n";
+        }
+
+        if (key == GLFW_KEY_P) {
+            if (Profiler::enabled()) Profiler::get().writeChromeTrace(profileOutput);
+            else std::cout << "Profiler is off, start with --profile\n";
+        }
     }
 }
 
 
 //all callbacks
 void allKeys(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    frameKeyEvents++;
     startRide(window, key, scancode, action, mods);
     addPassanger(window, key, scancode, action, mods);
-    sickPassenger(window, key, scancode, action, mods);
     putBeltOn(window, key, scancode, action, mods);
     removePassenger(window, key, scancode, action, mods);
     toggleRenderSettings(window, key, scancode, action, mods);  
 }
 
+//pravi ulaz ide kroz snimac, za vreme replay-a se ignorise
+void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods) {
+    if (inputReplay.active()) return;
+    if (inputRecorder.active()) inputRecorder.key(key, action, mods);
+    allKeys(window, key, scancode, action, mods);
+}
+
+void cursorCallback(GLFWwindow* window, double xpos, double ypos) {
+    if (inputReplay.active()) return;
+    if (inputRecorder.active()) inputRecorder.mouse(xpos, ypos);
+    mouse_callback(window, xpos, ypos);
+}
+
+//headless: ukrcaj sve, vezi pojaseve i kreni, isto kao da su pritisnuti tasteri
+void scriptedRideInput(GLFWwindow* window, int frame) {
+    if (frame == 0) {
+        for (unsigned int i = 0; i < riders.seats(); i++)
+            allKeys(window, GLFW_KEY_SPACE, 0, GLFW_PRESS, 0);
+    }
+    else if (frame == 1) {
+        for (unsigned int i = 0; i < seatKeys; i++)
+            allKeys(window, GLFW_KEY_1 + i, 0, GLFW_PRESS, 0);
+    }
+    else if (frame == 2) {
+        allKeys(window, GLFW_KEY_ENTER, 0, GLFW_PRESS, 0);
+    }
+}
+
 // ================= MAIN =================
-int main() {
-    if (!glfwInit()) return -1;
+int main(int argc, char** argv) {
+    parseOptions(argc, argv);
+
+    // brojanje operator new postoji samo u Debug / rc_alloc_check buildu (COUNT_ALLOCATIONS)
+    if (checkAllocations && !heapAllocationsCounted()) {
+        std::cout << "Allocation check: unavailable, operator new is not counted in this build (define COUNT_ALLOCATIONS)\n";
+        return -9;
+    }
+
+    // kapacitet stanice, vozovi na res/tracks.obj sa --trains / --blocks
+    if (guestFlowRequested) {
+        std::vector<glm::vec3> raw, keyPoints, path;
+        if (!loadTrackVertices("res/tracks.obj", raw)) return -7;
+        generateKeyPoints(raw, keyPoints, path);
+        guestFlow.run(path, trainCount, blockCount).print(std::cout);
+        return 0;
+    }
+
+    if (!exportTrackPath.empty()) {
+        std::vector<glm::vec3> raw, keyPoints, path;
+        if (!loadTrackVertices("res/tracks.obj", raw)) return -7;
+        generateKeyPoints(raw, keyPoints, path);
+        return writeControlPoints(exportTrackPath, path, "res/tracks.obj") ? 0 : -7;
+    }
 
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
-    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    if (!seating.load(seatingPath)) return -8;
+    carLayout = seating.find(carType);
+    if (!carLayout) return -8;
+    riders.resize(carLayout->seats());
+    sickness.resize(carLayout->seats());
 
-    GLFWmonitor* monitor = glfwGetPrimaryMonitor();
-    const GLFWvidmode* mode = glfwGetVideoMode(monitor);
-    int screenWidth = mode->width;
-    int screenHeight = mode->height;
+    GLFWwindow* window = NULL;
 
-    GLFWwindow* window = glfwCreateWindow(screenWidth, screenHeight, "OpenGL Window", NULL, NULL);
+    if (headless.enabled) {
+        window = createHeadlessWindow(indirectRequested ? 4 : 3, indirectRequested ? 6 : 3);
+        if (!window && indirectRequested) {
+            std::cout << "No GL 4.6 context, --mdi disabled\n";
+            indirectRequested = false;
+            window = createHeadlessWindow(3, 3);
+        }
+    }
+    else {
+        if (!glfwInit()) return -1;
+
+        // indirect crtanje trazi 4.6, ako ga nema pada se nazad na 3.3
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, indirectRequested ? 4 : 3);
+        glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, indirectRequested ? 6 : 3);
+        glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+
+        GLFWmonitor* monitor = glfwGetPrimaryMonitor();
+        const GLFWvidmode* mode = glfwGetVideoMode(monitor);
+        int screenWidth = mode->width;
+        int screenHeight = mode->height;
+
+        window = glfwCreateWindow(screenWidth, screenHeight, "OpenGL Window", NULL, NULL);
+        if (!window && indirectRequested) {
+            std::cout << "No GL 4.6 context, --mdi disabled\n";
+            indirectRequested = false;
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+            glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+            window = glfwCreateWindow(screenWidth, screenHeight, "OpenGL Window", NULL, NULL);
+        }
+    }
     if (!window) {
         std::cout << "Window fail!\n";
         glfwTerminate();
@@ -430,203 +841,454 @@ int main() {
         return -3;
     }
 
-    glfwSetKeyCallback(window, allKeys);
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
-    glfwSetCursorPosCallback(window, mouse_callback);
+    if (Profiler::enabled()) Profiler::get().enableGpu();
+
+    if (!replayPath.empty() && !inputReplay.open(replayPath)) {
+        glfwTerminate();
+        return -5;
+    }
+    // headless replay traje koliko i snimak, osim ako je --frames zadat
+    if (inputReplay.active() && headless.enabled && !headless.framesGiven)
+        headless.frames = (int)inputReplay.frameCount();
+    if (!recordPath.empty() && !inputRecorder.open(recordPath)) {
+        glfwTerminate();
+        return -5;
+    }
+
+    glfwSetKeyCallback(window, keyCallback);
+    if (!headless.enabled) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    glfwSetCursorPosCallback(window, cursorCallback);
 
 
-    Model tracks("res/tracks.obj");
-    Model car("res/car1.obj");
-    Model seats("res/seats.obj");
-    Model beltModel("res/belt.obj");
+    if (scenePath.empty()) park.addTrack(proceduralTrack ? "res/coaster.track" : "res/tracks.obj", glm::mat4(1.0f), trainCount);
+    else if (!park.load(scenePath, trainCount)) {
+        glfwTerminate();
+        return -6;
+    }
+    if (!park.finish(blockCount)) {
+        glfwTerminate();
+        return -6;
+    }
 
+    // rezultati upita se ne alociraju u frejmu
+    visibleObjects.reserve(park.objects.size());
+    nearbyObjects.reserve(park.objects.size());
 
-    passengerModels.push_back(Model("res/mei/mei.obj"));
-    passengerModels.push_back(Model("res/old-lady/old-lady.obj"));
-    passengerModels.push_back(Model("res/football-fan/football-fan.obj"));
-    passengerModels.push_back(Model("res/person1/person1.obj"));
-    passengerModels.push_back(Model("res/person2/person2.obj"));
-    passengerModels.push_back(Model("res/soldier/soldier.obj"));
-    passengerModels.push_back(Model("res/person3/person3.obj"));
-    passengerModels.push_back(Model("res/doctor/doctor.obj"));
+    comfortMap.analyse(park.tracks[0].path, riderTrains().params);
+    comfortMap.print(std::cout);
+
+    Model car(carLayout->carModel);
+    Model seats(carLayout->seatsModel);
+    Model beltModel("res/belt.obj");
 
-    Shader unifiedShader("basic.vert", "basic.frag");
+    std::vector<std::string> riderPaths;
+    for (const RiderFit& rider : seating.riders)
+        riderPaths.push_back(rider.path);
+    passengerModels.setPaths(riderPaths);
+    passengerModels.synchronous = headless.enabled || inputReplay.active();
+
+    std::string lightDefines = parkLightCount > 0 ? ClusteredLighting::defines() : std::string();
+    if (shadowsEnabled) shadowsEnabled = shadows.create();
+    if (shadowsEnabled) lightDefines += "#define SHADOWS\n";
+    Shader shadowShader("shadow.vert", "shadow.frag");
+    Shader unifiedShader("basic.vert", "basic.frag", lightDefines);
 
     unifiedShader.use();
     unifiedShader.setVec3("uTint", 1.0f, 1.0f, 1.0f);
 
     Shader overlayShader("overlay.vert", "overlay.frag");
+    std::cout << "Shaders " << (unifiedShader.loadedFromCache && overlayShader.loadedFromCache ? "loaded from the binary cache" : "compiled from source") << "\n";
  
     unsigned int greenOverlayVAO, greenOverlayVBO;
     setupGreenFilter(greenOverlayVAO, greenOverlayVBO);
     unsigned int greenTexture = createGreenFilter();
 
+    Shader comfortShader("comfort.vert", "comfort.frag");
+    unsigned int comfortVAO, comfortVBO;
+    unsigned int comfortVertexCount = setupComfortOverlay(comfortVAO, comfortVBO, park.tracks[0].path, comfortMap);
+
 
-    unifiedShader.setVec3("uLightPos1", 50, 100, 75);
-    unifiedShader.setVec3("uLightColor1", 2, 2, 2);
-    unifiedShader.setVec3("uLightPos2", -50, 0, 0);
-    unifiedShader.setVec3("uLightColor2", 0.5, 0.5, 0.5);
-    unifiedShader.setVec3("uViewPos", 0, 0, 5);
+    setLightUniforms(unifiedShader);
 
-    loadTrackVertices("res/tracks.obj");
-    generateKeyPoints();
+    // deferred put: isti basic.frag, jednom bez osvetljenja (G-buffer), jednom kao full screen osvetljenje
+    Shader gbufferShader("basic.vert", "basic.frag", "#define GBUFFER\n");
+    Shader lightingShader("deferred.vert", "basic.frag", "#define DEFERRED_LIGHTING\n" + lightDefines);
+    lightingShader.use();
+    setLightUniforms(lightingShader);
+    unifiedShader.use();
+    gbuffer.create();
+    shadingTimer.create();
+
+    Shader depthShader("basic.vert", "shadow.frag", "#define DEPTH_ONLY\n");
+    Shader overdrawShader("basic.vert", "basic.frag", "#define OVERDRAW\n");
+
+    // pragovi i stubovi generisanih staza se crtaju instancirano, matrica je atribut po instanci
+    Shader* instancedShader = nullptr;
+    Shader* gbufferInstancedShader = nullptr;
+    Shader* overdrawInstancedShader = nullptr;
+    Shader* shadowInstancedShader = nullptr;
+    if (park.trackParts.ready()) {
+        instancedShader = new Shader("basic.vert", "basic.frag", "#define INSTANCED\n" + lightDefines);
+        instancedShader->use();
+        setLightUniforms(*instancedShader);
+        gbufferInstancedShader = new Shader("basic.vert", "basic.frag", "#define INSTANCED\n#define GBUFFER\n");
+        overdrawInstancedShader = new Shader("basic.vert", "basic.frag", "#define INSTANCED\n#define OVERDRAW\n");
+        shadowInstancedShader = new Shader("shadow.vert", "shadow.frag", "#define INSTANCED\n");
+    }
+    unifiedShader.use();
+    fragmentCounter.create();
+
+    if (shadowsEnabled) {
+        // root celija octree-a obuhvata sve staticno
+        shadows.setLight(-sunPosition, park.octree.center(), park.octree.halfSize() * 1.7321f);
+    }
+
+    if (parkLightCount > 0) {
+        placeParkLights(parkLightCount);
+        parkLights.create((unsigned int)parkLights.lights.size());
+        std::cout << "Park lights: " << parkLights.lights.size() << " in " << ClusteredLighting::clusterCount << " clusters\n";
+    }
+
+    IndirectRenderer indirect;
+    Shader* indirectShader = nullptr;
+    Shader* gbufferIndirectShader = nullptr;
+    Shader* overdrawIndirectShader = nullptr;
+    if (indirectRequested) {
+        if (IndirectRenderer::supported()) {
+            for (Model& m : park.models) indirect.addModel(m);
+            indirect.addModel(car);
+            indirect.addModel(seats);
+            indirect.addModel(beltModel);
+            // MDI pool se pravi jednom, putnici se zato ucitavaju odmah i ostaju
+            passengerModels.loadAll();
+            for (unsigned int i = 0; i < passengerModels.count(); i++) indirect.addModel(*passengerModels.get(i));
+            indirect.build();
+
+            if (indirect.ready()) {
+                indirectShader = new Shader("indirect.vert", "basic.frag", "#define INDIRECT\n" + lightDefines);
+                indirectShader->use();
+                setLightUniforms(*indirectShader);
+                gbufferIndirectShader = new Shader("indirect.vert", "basic.frag", "#define INDIRECT\n#define GBUFFER\n");
+                overdrawIndirectShader = new Shader("indirect.vert", "basic.frag", "#define INDIRECT\n#define OVERDRAW\n");
+                unifiedShader.use();
+                indirectRenderer = &indirect;
+            }
+        }
+        else {
+            std::cout << "Multi draw indirect not supported, using the classic path\n";
+        }
+    }
+
+    for (SceneTrack& track : park.tracks)
+        std::cout << "Trains: " << track.trains.count() << " on " << track.trains.blocks() << " block sections\n";
+
+    // MDI pool je vec napravljen iz CPU kopija, posle toga crta se samo iz GL bafera
+    if (releaseGeometry) {
+        for (Model& m : park.models) m.releaseGeometry();
+        car.releaseGeometry();
+        seats.releaseGeometry();
+        beltModel.releaseGeometry();
+        for (unsigned int i = 0; i < passengerModels.count(); i++)
+            if (Model* rider = passengerModels.get(i)) rider->releaseGeometry();
+        passengerModels.releaseGeometry = true;
+    }
+    reportMemory(std::cout, car, seats, beltModel, memoryReportDetail);
+    carPosition = riderTrains().position[riderTrain];
 
-    if (!sortedPoints.empty()) carPosition = sortedPoints[0];
+    // kamera u headless modu kruzi oko staze sa putnicima
+    glm::vec3 riderTrackCenter;
+    float riderTrackRadius;
+    park.trackSphere(0, riderTrackCenter, riderTrackRadius);
 
     glEnable(GL_DEPTH_TEST);
 
-    glClearColor(0.12f, 0.8f, 1.0f, 1.0f);
+    // benchmark radi sto brze moze
+    framePacer.setTargetRate(headless.enabled || inputReplay.fast ? 0.0 : targetFrameRate);
+    framePacer.setVsync(vsyncEnabled && !headless.enabled);
+
+    OffscreenTarget offscreen;
+    HeadlessRun headlessRun;
+    int headlessFrame = 0;
+    float aspect = 1280.0f / 720.0f;
+    if (headless.enabled) {
+        if (!offscreen.create(headless.width, headless.height) || !headlessRun.begin(headless)) {
+            glfwTerminate();
+            return -4;
+        }
+        aspect = (float)headless.width / (float)headless.height;
+    }
+
+    glClearColor(skyColor.x, skyColor.y, skyColor.z, skyColor.w);
 
     double lastTime = glfwGetTime();
     glm::mat4 passengerRotation = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(0.0f, -1.0f, 0.0f));
-    glm::vec3 cameraHeightOffset(0.0f, 1.5f, 0.0f);
+    buildTrainRigs(passengerRotation);
 
-    glm::mat4 view;
+    glm::mat4 view = glm::lookAt(glm::vec3(-40.0f, 0.0f, -35.0f), glm::vec3(-20.0f, 10.0f, 15.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+    if (headless.enabled) view = scriptedCameraView(riderTrackCenter, riderTrackRadius, 0, headless.frames);
+    double lastCullReport = lastTime;
+    double lastPacerReport = lastTime;
+    framePacer.reset();
 
     while (!glfwWindowShouldClose(window)) {
+        PROFILE_SCOPE("frame");
+        frameMemory.beginFrame();
+        frameKeyEvents = 0;
+        unsigned long long frameHeapStart = heapAllocations();
+        bool quietFrame = !passengerModels.loading() && !memoryReportRequested;
         double currentTime = glfwGetTime();
         float deltaTime = static_cast<float>(currentTime - lastTime);
         lastTime = currentTime;
 
+        if (headless.enabled) {
+            deltaTime = headless.frameStep;
+            offscreen.bind();
+            headlessRun.beginFrame();
+            if (!inputReplay.active()) scriptedRideInput(window, headlessFrame);
+        }
+        if (inputReplay.active()) deltaTime = inputReplay.deltaTime();
+        if (inputRecorder.active()) inputRecorder.beginFrame(currentTime, deltaTime);
+
         if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS)
             glfwSetWindowShouldClose(window, true);
 
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        if (!sortedPoints.empty()) {
-
-            // indeksi za interpolaciju
-            int n = sortedPoints.size();
-            int i0 = (int)(t * n);
-            int i1 = (i0 + 1) % n;
-            float alpha = t * n - i0;
-
-            glm::vec3 p1 = sortedPoints[i0];
-            glm::vec3 p2 = sortedPoints[i1];
-
-            // nagib i ubrzanje
-            float dy = p2.y - p1.y;
-            float acc = -dy * gravityFactor;
-
-            switch (carState) {
-            case MOVING:
-                carSpeed += acc * deltaTime;
-                carSpeed = glm::clamp(carSpeed, minSpeed, maxSpeed);
-                t += carSpeed * deltaTime;
-                break;
-            case SLOWING_DOWN:
-                carSpeed -= 0.1f * deltaTime;
-                if (carSpeed <= 0.0f) { carSpeed = 0.0f; carState = WAITING; waitTimer = 0.0f; }
-                else t += carSpeed * deltaTime;
-                break;
-            case WAITING:
-                waitTimer += deltaTime;
-                if (waitTimer >= 10.0f) {
-                    carSpeed = 0.1f;
-                    carState = RETURNING;
-                }
-                break;
-            case RETURNING:
-                t -= carSpeed * deltaTime;
-                if (t <= 0.0f) { t = 0.0f; carState = STOPPED; carSpeed = 0.0f; stopCar(); }
-                break;
-            case STOPPED:
-                carSpeed = 0.0f;
-                break;
+        {
+            PROFILE_SCOPE("physics");
+            CarState riderBefore = riderTrains().state[riderTrain];
+            for (SceneTrack& track : park.tracks)
+                track.trains.update(deltaTime);
+            if (riderBefore == RETURNING && riderTrains().state[riderTrain] == STOPPED) stopCar();
+
+            // muka dolazi od staze: doza raste na segmentima preko granice udobnosti
+            if (riderTrains().state[riderTrain] == MOVING) {
+                sickness.update(riders, comfortMap.scoreAt(riderTrains().t[riderTrain]), comfortMap.limits.intense, deltaTime);
+                for (unsigned int seat : sickness.becameSick) makePassengerSick(seat);
             }
 
-            if (t >= 1.0f) t -= floor(t);
-            if (t < 0.0f) t += 1.0f;
+            carPosition = riderTrains().position[riderTrain];
+            carFront = riderTrains().front[riderTrain];
+        }
 
-            carPosition = glm::mix(p1, p2, alpha);
-            carFront = glm::normalize(p2 - p1);
+        // gotovi modeli putnika idu na GPU, oni u kojima niko ne sedi se izbacuju ako je budzet prekoracen
+        for (unsigned int seat : riders.active())
+            passengerModels.touch(riders.model[seat]);
+        passengerModels.update();
+        if (memoryReportRequested) {
+            reportMemory(std::cout, car, seats, beltModel, true);
+            memoryReportRequested = false;
         }
 
        
-        glm::mat4 projection = glm::perspective(glm::radians(45.0f), 1280.0f / 720.0f, 0.1f, 100.0f);
+        glm::mat4 projection = glm::perspective(glm::radians(45.0f), aspect, 0.1f, 100.0f);
  
 
         unifiedShader.setMat4("uP", projection);
-        unifiedShader.setMat4("uM", glm::mat4(1.0f));
-        tracks.Draw(unifiedShader);
-
-        glm::mat4 modelCar = glm::mat4(1.0f);
-        //modelCar = glm::translate(modelCar, carPosition );
-        modelCar = glm::translate(modelCar, carPosition + glm::vec3(0.2f, 1.5f, 0.65f));
-
-        glm::vec3 worldUp = glm::vec3(0.0f, 1.0f, 0.0f);
-        glm::vec3 right = glm::normalize(glm::cross(worldUp, carFront));
-        glm::vec3 up = glm::cross(carFront, right);
-
-        glm::mat4 rotationMatrix = glm::mat4(1.0f);
-        rotationMatrix[0] = glm::vec4(right, 0.0f);
-        rotationMatrix[1] = glm::vec4(up, 0.0f);
-        rotationMatrix[2] = glm::vec4(-carFront, 0.0f); 
-
-        modelCar = modelCar * rotationMatrix;
-        modelCar = glm::scale(modelCar, glm::vec3(0.8f));
-
-        unifiedShader.setMat4("uM", modelCar);
-        car.Draw(unifiedShader);
-
-
-        glm::mat4 modelSeats = glm::mat4(1.0f);
-        modelSeats = glm::translate(modelSeats, carPosition + glm::vec3(0.2f, 1.5f, 0.65f));
-        modelSeats = modelSeats * rotationMatrix;             
-        modelSeats = glm::translate(modelSeats, seatsOffset); 
-        modelSeats = glm::scale(modelSeats, glm::vec3(0.8f));
-
-        unifiedShader.setMat4("uM", modelSeats);
-        seats.Draw(unifiedShader);
-
-
-        for (const Passenger& p : passengers) {
-            if (!p.active) continue;
-
-            if (p.isSick)
-                unifiedShader.setVec3("uTint", 0.2f, 1.0f, 0.2f);
-            else
-                unifiedShader.setVec3("uTint", 1.0f, 1.0f, 1.0f);
-
-            PassengerModelData& data = modelData[p.index];
-
-            glm::mat4 modelPassenger = glm::mat4(1.0f);
-            modelPassenger = glm::translate(modelPassenger, carPosition);
-            modelPassenger = modelPassenger * rotationMatrix;
-            modelPassenger = modelPassenger * passengerRotation;
-            
-            modelPassenger = glm::translate(modelPassenger, glm::vec3(p.offsetX, p.offsetY, p.offsetZ));
-            modelPassenger = modelPassenger * rotationMatrix;
-            modelPassenger = glm::translate(modelPassenger, data.positionOffset);
-            modelPassenger = glm::scale(modelPassenger, glm::vec3(data.scale));
-            unifiedShader.setMat4("uM", modelPassenger);
-            passengerModels[p.index].Draw(unifiedShader);
-
-            if (p.beltOn) {
-                glm::mat4 modelBelt = glm::mat4(1.0f);
-                modelBelt = glm::translate(modelBelt, carPosition);
-                modelBelt = modelBelt * rotationMatrix; 
-                modelBelt = modelBelt * passengerRotation; 
-                //modelBelt = glm::translate(modelBelt, glm::vec3(p.offsetX - 0.2f, p.offsetY + 1.5f, p.offsetZ - 0.1f));
-                modelBelt = glm::translate(modelBelt, glm::vec3(p.offsetX - 0.5f, p.offsetY + 1.8f, p.offsetZ+ 0.53f));
-                modelBelt = glm::rotate(modelBelt, glm::radians(90.0f), glm::vec3(0.0f, 1.0f, 0.0f));
-                modelBelt = glm::scale(modelBelt, glm::vec3(1.0f));
-
-                unifiedShader.setMat4("uM", modelBelt);
-                beltModel.Draw(unifiedShader);
+
+        // uV is still the one set at the end of the previous frame, cull against the same matrix
+        cullStats.reset();
+        frustum.extract(projection * view);
+
+        updateTrainTransforms();
+        buildRiderDraws();
+
+        if (shadows.ready()) {
+            PROFILE_SCOPE("shadows");
+            PROFILE_GPU_SCOPE("shadows");
+            if (shadows.beginStatic(shadowShader)) {
+                for (const SceneObject& object : park.objects)
+                    drawShadowCaster(park.models[object.model], shadowShader, object.transform);
+                if (shadowInstancedShader) {
+                    shadowInstancedShader->use();
+                    shadowInstancedShader->setMat4("uLightSpace", shadows.staticLightSpace());
+                    park.trackParts.drawDepth();
+                }
+                shadows.end();
             }
+
+            // dinamicki atlas: po tile za svaki voz cija senka moze da padne u kadar, putnici su u tile-u svog voza
+            unsigned int* casterRigs = frameMemory.allocate<unsigned int>(trainRigs.size());
+            glm::vec4* casterSpheres = frameMemory.allocate<glm::vec4>(trainRigs.size());
+            unsigned int casterCount = 0;
+            for (unsigned int i = 0; i < trainRigs.size(); i++) {
+                const TrainRig& rig = trainRigs[i];
+                glm::vec4 sphere = mergeSpheres(casterSphere(car, transforms.world(rig.car)), casterSphere(seats, transforms.world(rig.seats)));
+                if (rig.track == 0 && rig.train == riderTrain) {
+                    for (unsigned int r = 0; r < riderDrawCount; r++) {
+                        const RiderDraw& draw = riderDraws[r];
+                        if (draw.model) sphere = mergeSpheres(sphere, casterSphere(*draw.model, draw.rider));
+                        if (draw.belted) sphere = mergeSpheres(sphere, casterSphere(beltModel, draw.belt));
+                    }
+                }
+                if (frustumCullingEnabled && !shadows.reachesView(frustum, glm::vec3(sphere), sphere.w)) continue;
+                casterRigs[casterCount] = i;
+                casterSpheres[casterCount] = sphere;
+                casterCount++;
+            }
+
+            shadows.beginDynamic(shadowShader, casterSpheres, casterCount);
+            for (unsigned int c = 0; c < casterCount; c++) {
+                const TrainRig& rig = trainRigs[casterRigs[c]];
+                shadows.dynamicCaster(shadowShader, c);
+                drawShadowCaster(car, shadowShader, transforms.world(rig.car));
+                drawShadowCaster(seats, shadowShader, transforms.world(rig.seats));
+                if (rig.track != 0 || rig.train != riderTrain) continue;
+                for (unsigned int i = 0; i < riderDrawCount; i++) {
+                    const RiderDraw& draw = riderDraws[i];
+                    if (draw.model) drawShadowCaster(*draw.model, shadowShader, draw.rider);
+                    if (draw.belted) drawShadowCaster(beltModel, shadowShader, draw.belt);
+                }
+            }
+            shadows.end();
+
+            unifiedShader.use();
+            shadows.bind(unifiedShader);
         }
 
-      
-        if (activeCameraPassenger == 0 && !passengers.empty()) {
-            glm::mat4 headPosMatrix = glm::mat4(1.0f);
-            headPosMatrix = glm::translate(headPosMatrix, carPosition);
-            headPosMatrix = headPosMatrix * rotationMatrix;
-            headPosMatrix = headPosMatrix * passengerRotation;
+        if (parkLights.ready()) {
+            parkLights.update(view, projection, 0.1f, 100.0f);
+            parkLights.bind(unifiedShader);
+        }
+
+        ProfileScope sceneScope("scene");
+        GpuProfileScope sceneGpuScope("scene");
+
+        // u deferred modu scena ide u G-buffer, osvetljenje posle u jednom prolazu
+        bool deferredFrame = deferredShading && !overdrawView && gbuffer.ready();
+        bool prepassFrame = depthPrepassEnabled && !deferredFrame && !indirectRenderer;
+        Shader& sceneShader = overdrawView ? overdrawShader : deferredFrame ? gbufferShader : unifiedShader;
+        shadingTimer.begin(deferredFrame ? ShadingTimer::DEFERRED : ShadingTimer::FORWARD);
+        if (deferredFrame) gbuffer.begin();
+        if (overdrawView) {
+            glClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_ONE, GL_ONE);
+        }
+        if (&sceneShader != &unifiedShader) {
+            sceneShader.use();
+            sceneShader.setMat4("uP", projection);
+            sceneShader.setMat4("uV", view);
+            sceneShader.setVec3("uTint", 1.0f, 1.0f, 1.0f);
+        }
+        if (indirectRenderer) indirectRenderer->beginFrame();
+
+        // staticni deo parka, octree vraca samo ono sto je u frustumu
+        if (frustumCullingEnabled) park.visible(frustum, visibleObjects);
+
+        if (prepassFrame) {
+            PROFILE_SCOPE("depth prepass");
+            beginDepthPrepass();
+            depthShader.use();
+            depthShader.setMat4("uP", projection);
+            depthShader.setMat4("uV", view);
+            if (frustumCullingEnabled) {
+                for (unsigned int id : visibleObjects)
+                    drawModelDepth(park.models[park.objects[id].model], depthShader, park.objects[id].transform);
+            }
+            else {
+                for (const SceneObject& object : park.objects)
+                    drawModelDepth(park.models[object.model], depthShader, object.transform);
+            }
+            for (const TrainRig& rig : trainRigs) {
+                drawModelDepth(car, depthShader, transforms.world(rig.car));
+                drawModelDepth(seats, depthShader, transforms.world(rig.seats));
+            }
+            for (unsigned int i = 0; i < riderDrawCount; i++) {
+                const RiderDraw& draw = riderDraws[i];
+                if (draw.model) drawModelDepth(*draw.model, depthShader, draw.rider);
+                if (draw.belted) drawModelDepth(beltModel, depthShader, draw.belt);
+            }
+            beginEqualDepthPass();
+            sceneShader.use();
+        }
+        fragmentCounter.begin();
+
+        if (frustumCullingEnabled) {
+            for (unsigned int id : visibleObjects)
+                drawModel(park.models[park.objects[id].model], sceneShader, park.objects[id].transform);
+        }
+        else {
+            for (const SceneObject& object : park.objects)
+                drawModel(park.models[object.model], sceneShader, object.transform);
+        }
+
+        // svi vozovi, putnicki je prvi
+        for (const TrainRig& rig : trainRigs) {
+            drawModel(car, sceneShader, transforms.world(rig.car));
+            drawModel(seats, sceneShader, transforms.world(rig.seats));
+        }
 
-            glm::vec3 p0Offset = glm::vec3(passengers[0].offsetX - 1.0f, passengers[0].offsetY + 0.8f, passengers[0].offsetZ);
-            headPosMatrix = glm::translate(headPosMatrix, p0Offset + cameraHeightOffset);
-            glm::vec3 eyePos = glm::vec3(headPosMatrix[3]) + glm::vec3(0.0f, 1.0f, 0.0f);
+        for (unsigned int i = 0; i < riderDrawCount; i++) {
+            const RiderDraw& draw = riderDraws[i];
+            if (!indirectRenderer)
+                sceneShader.setVec3("uTint", draw.tint);
+
+            if (draw.model)
+                drawModel(*draw.model, sceneShader, draw.rider, draw.tint);
+
+            if (draw.belted)
+                drawModel(beltModel, sceneShader, draw.belt);
+        }
+
+        if (indirectRenderer) {
+            // isti uV kao klasican put (iz prethodnog frejma)
+            Shader& indirectSceneShader = overdrawView ? *overdrawIndirectShader : deferredFrame ? *gbufferIndirectShader : *indirectShader;
+            indirectSceneShader.use();
+            indirectSceneShader.setMat4("uP", projection);
+            indirectSceneShader.setMat4("uV", view);
+            if (!deferredFrame && parkLights.ready()) parkLights.bind(indirectSceneShader);
+            if (!deferredFrame && shadows.ready()) shadows.bind(indirectSceneShader);
+            indirectRenderer->flush(indirectSceneShader);
+        }
+        fragmentCounter.end();
+        if (prepassFrame) endDepthPrepass();
+
+        // posle pre-pass-a jer nisu u njemu (GL_EQUAL bi ih odbacio)
+        if (instancedShader) {
+            Shader& partsShader = overdrawView ? *overdrawInstancedShader : deferredFrame ? *gbufferInstancedShader : *instancedShader;
+            partsShader.use();
+            partsShader.setMat4("uP", projection);
+            partsShader.setMat4("uV", view);
+            partsShader.setVec3("uTint", 0.6f, 0.6f, 0.65f);
+            if (&partsShader == instancedShader && parkLights.ready()) parkLights.bind(partsShader);
+            if (&partsShader == instancedShader && shadows.ready()) shadows.bind(partsShader);
+            park.trackParts.draw(partsShader);
+        }
+        if (overdrawView) {
+            glDisable(GL_BLEND);
+            glClearColor(skyColor.x, skyColor.y, skyColor.z, skyColor.w);
+        }
+
+        if (deferredFrame) {
+            lightingShader.use();
+            lightingShader.setMat4("uV", view);
+            if (parkLights.ready()) parkLights.bind(lightingShader);
+            if (shadows.ready()) shadows.bind(lightingShader);
+            gbuffer.light(lightingShader, projection * view);
+        }
+        if (comfortView && comfortVertexCount > 1) {
+            comfortShader.use();
+            comfortShader.setMat4("uP", projection);
+            comfortShader.setMat4("uV", view);
+            glBindVertexArray(comfortVAO);
+            glDrawArrays(GL_LINE_LOOP, 0, comfortVertexCount);
+            glBindVertexArray(0);
+        }
+        unifiedShader.use();
+        shadingTimer.end();
+
+        sceneGpuScope.end();
+        sceneScope.end();
+
+      
+        ProfileScope cameraScope("camera");
+        if (headless.enabled) {
+            view = scriptedCameraView(riderTrackCenter, riderTrackRadius, headlessFrame + 1, headless.frames);
+        }
+        else if (activeCameraPassenger == 0 && !riders.allGone()) {
+            glm::vec3 eyePos = glm::vec3(transforms.world(riderRig.camera)[3]) + glm::vec3(0.0f, 1.0f, 0.0f);
 
             glm::vec3 relativeFront;
             relativeFront.x = cos(glm::radians(yaw)) * cos(glm::radians(pitch));
@@ -634,7 +1296,8 @@ int main() {
             relativeFront.z = sin(glm::radians(yaw)) * cos(glm::radians(pitch));
             relativeFront = glm::normalize(relativeFront);
 
-            glm::vec3 finalFront = glm::vec3(rotationMatrix * passengerRotation * glm::vec4(relativeFront, 0.0f));
+            glm::vec3 finalFront = glm::vec3(transforms.world(riderRig.seatFrame) * glm::vec4(relativeFront, 0.0f));
+            glm::vec3 up = glm::vec3(transforms.world(riderRig.frame)[1]);
 
             view = glm::lookAt(eyePos, eyePos + finalFront, up);
         }
@@ -644,6 +1307,8 @@ int main() {
             //view = glm::lookAt(glm::vec3(40.0f, 0.0f, -20.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));;
         }
 
+        cameraScope.end();
+
         unifiedShader.setMat4("uV", view);
 
         unifiedShader.setVec3("uTint", 1.0f, 1.0f, 1.0f);
@@ -651,7 +1316,9 @@ int main() {
         unifiedShader.use();
         glm::mat4 currentView = view;
 
-        if (!passengers.empty() && passengers[0].active && passengers[0].isSick) {
+        if (riders.isSick(0)) {
+            PROFILE_SCOPE("overlay");
+            PROFILE_GPU_SCOPE("overlay");
             glDisable(GL_DEPTH_TEST);
 
             glEnable(GL_BLEND);
@@ -675,12 +1342,96 @@ int main() {
             unifiedShader.setMat4("uV", currentView);
         }
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+        if (currentTime - lastCullReport >= 1.0) {
+            park.nearby(carPosition, 30.0f, nearbyObjects);
+            std::cout << "Meshes drawn: " << cullStats.drawn << ", culled: " << cullStats.culled
+                      << " | scene objects visible: " << visibleObjects.size() << "/" << park.objects.size() << ", near the rider car: " << nearbyObjects.size();
+            if (indirectRenderer)
+                std::cout << " (" << indirectRenderer->drawCount << " draws in " << indirectRenderer->batchCount << " multi draw calls)";
+            if (parkLights.ready())
+                std::cout << " | light/cluster pairs: " << parkLights.assigned << ", busiest cluster: " << parkLights.busiestCluster;
+            if (shadows.ready())
+                std::cout << " | static shadow renders: " << shadows.staticRenders << ", train shadow tiles: " << shadows.dynamicTiles();
+            double overdraw = fragmentCounter.takeAverage();
+            if (overdraw >= 0.0)
+                std::cout << " | shaded fragments per pixel: " << overdraw << (depthPrepassEnabled && !indirectRenderer ? " (pre-pass)" : "");
+            std::cout << "\n";
+            lastCullReport = currentTime;
+        }
+        if (currentTime - lastPacerReport >= 5.0) {
+            framePacer.report(std::cout);
+            shadingTimer.report(std::cout);
+            lastPacerReport = currentTime;
+        }
+
+        if (headless.enabled) {
+            if (headlessRun.captures(headlessFrame)) quietFrame = false;
+            headlessRun.endFrame(headlessFrame, cullStats.drawn, cullStats.culled, offscreen);
+            if (++headlessFrame >= headless.frames) glfwSetWindowShouldClose(window, true);
+        }
+
+        {
+            PROFILE_SCOPE("swap");
+            if (!headless.enabled) glfwSwapBuffers(window);
+            glfwPollEvents();
+        }
+
+        // events of this frame are applied at the same point they arrived while recording
+        if (inputReplay.active()) {
+            inputReplay.dispatch(window, allKeys, mouse_callback);
+            if (inputReplay.finished()) {
+                std::cout << "Replay finished after " << inputReplay.frameIndex() << " frames\n";
+                glfwSetWindowShouldClose(window, true);
+            }
+        }
+        if (inputRecorder.active()) inputRecorder.endFrame();
 
-        while (glfwGetTime() - currentTime < 1 / 75.0) {}
+        // recorded timing: the next frame lasts as long as it did while recording
+        if (inputReplay.active() && !inputReplay.fast && !headless.enabled)
+            framePacer.setTargetRate(inputReplay.deltaTime() > 0.0f ? 1.0 / inputReplay.deltaTime() : 0.0);
+
+        {
+            PROFILE_SCOPE("pace");
+            framePacer.waitForNextFrame();
+        }
+        Profiler::get().collectGpu();
+        shadingTimer.collect();
+        fragmentCounter.collect();
+
+        if (checkAllocations)
+            allocationCheck.frame(heapAllocations() - frameHeapStart, quietFrame && frameKeyEvents == 0 && !passengerModels.loading());
     }
-    
+
+    framePacer.report(std::cout);
+    if (Profiler::enabled()) Profiler::get().writeChromeTrace(profileOutput);
+    inputRecorder.close();
+    if (headless.enabled) {
+        headlessRun.finish();
+        offscreen.release();
+    }
+    indirectRenderer = nullptr;
+    indirect.release();
+    passengerModels.release();
+    parkLights.release();
+    shadows.release();
+    gbuffer.release();
+    shadingTimer.release();
+    fragmentCounter.release();
+    delete indirectShader;
+    delete gbufferIndirectShader;
+    delete overdrawIndirectShader;
+    park.trackParts.release();
+    delete instancedShader;
+    delete gbufferInstancedShader;
+    delete overdrawInstancedShader;
+    delete shadowInstancedShader;
     glfwTerminate();
+
+    if (checkAllocations) {
+        if (!replayPath.empty() && !inputReplay.finished()) allocationCheck.incomplete("replay did not finish");
+        allocationCheck.report(std::cout);
+        std::cout << "Frame memory: peak " << frameMemory.peak() << " bytes, " << frameMemory.heapGrowths() << " heap growths\n";
+        if (!allocationCheck.passed()) return -9;
+    }
     return 0;
 }
\ No newline at end of file
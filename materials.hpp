@@ -0,0 +1,177 @@
+#ifndef MATERIALS_H
+#define MATERIALS_H
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <map>
+#include <vector>
+
+// Diffuse textures packed into GL_TEXTURE_2D_ARRAY layers, so draws with different textures can share one
+// multi draw (indirect.hpp). Textures are grouped in square power of two size classes; every texture is
+// read back from its GL texture, converted to RGBA8 and resampled to its class size, so any model's
+// textures fit without re-decoding the files. A draw then only needs a layer index, and the frame binds
+// one array per size class instead of one texture per model.
+class MaterialArrays
+{
+public:
+    static const int minSize = 256;
+    static const int maxSize = 1024;       // bigger textures are scaled down to this
+
+    // material for a GL texture (0 = untextured, gets a white layer), call before build()
+    unsigned int add(GLuint texture)
+    {
+        std::map<GLuint, unsigned int>::iterator it = byTexture.find(texture);
+        if (it != byTexture.end()) return it->second;
+
+        unsigned int material = (unsigned int)materials.size();
+        Material m;
+        m.texture = texture;
+        m.sizeClass = classFor(texture ? textureSize(texture) : minSize);
+        m.layer = (unsigned int)classes[m.sizeClass].textures.size();
+        classes[m.sizeClass].textures.push_back(texture);
+        materials.push_back(m);
+        byTexture[texture] = material;
+        return material;
+    }
+
+    // creates one array per used size class and fills the layers, needs GL 4.2 (glTexStorage3D)
+    void build()
+    {
+        std::vector<unsigned char> source, layer;
+        for (SizeClass& sizeClass : classes) {
+            if (sizeClass.textures.empty()) continue;
+            int size = sizeClass.size;
+            int levels = 1 + (int)std::floor(std::log2((float)size));
+
+            glGenTextures(1, &sizeClass.array);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, sizeClass.array);
+            glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, GL_RGBA8, size, size, (GLsizei)sizeClass.textures.size());
+
+            layer.resize((size_t)size * size * 4);
+            glPixelStorei(GL_PACK_ALIGNMENT, 1);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+            for (size_t i = 0; i < sizeClass.textures.size(); i++) {
+                GLuint texture = sizeClass.textures[i];
+                int w = 0, h = 0;
+                if (texture) {
+                    glBindTexture(GL_TEXTURE_2D, texture);
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+                    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+                }
+                if (w > 0 && h > 0) {
+                    // GL does the format conversion, a GL_RED texture comes back as (r, 0, 0, 1) like it samples
+                    source.resize((size_t)w * h * 4);
+                    glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, source.data());
+                    resample(source.data(), w, h, layer.data(), size);
+                }
+                else {
+                    std::fill(layer.begin(), layer.end(), (unsigned char)255);
+                }
+                glBindTexture(GL_TEXTURE_2D_ARRAY, sizeClass.array);
+                glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, (GLint)i, size, size, 1, GL_RGBA, GL_UNSIGNED_BYTE, layer.data());
+                bytes += (size_t)size * size * 4 * 4 / 3;
+            }
+            glPixelStorei(GL_PACK_ALIGNMENT, 4);
+            glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+            glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        }
+        glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        std::cout << "Materials: " << materials.size() << " textures in " << arrayCount() << " texture arrays ("
+                  << bytes / (1024 * 1024) << " MB)\n";
+    }
+
+    void release()
+    {
+        for (SizeClass& sizeClass : classes) {
+            if (sizeClass.array) glDeleteTextures(1, &sizeClass.array);
+            sizeClass.array = 0;
+        }
+    }
+
+    size_t textureBytes() const { return bytes; }
+
+    GLuint arrayOf(unsigned int material) const { return classes[materials[material].sizeClass].array; }
+    unsigned int layerOf(unsigned int material) const { return materials[material].layer; }
+
+    unsigned int arrayCount() const
+    {
+        unsigned int n = 0;
+        for (const SizeClass& sizeClass : classes) n += sizeClass.textures.empty() ? 0 : 1;
+        return n;
+    }
+
+private:
+    struct Material {
+        GLuint texture;
+        unsigned int sizeClass;
+        unsigned int layer;
+    };
+
+    struct SizeClass {
+        int size;
+        GLuint array;
+        std::vector<GLuint> textures;      // source texture per layer
+    };
+
+    std::vector<Material> materials;
+    std::map<GLuint, unsigned int> byTexture;
+    SizeClass classes[3] = { { 256, 0, {} }, { 512, 0, {} }, { 1024, 0, {} } };
+    size_t bytes = 0;
+
+    static int textureSize(GLuint texture)
+    {
+        GLint w = 0, h = 0;
+        glBindTexture(GL_TEXTURE_2D, texture);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        return std::max(w, h);
+    }
+
+    // smallest class that holds the texture without scaling it down, the largest one otherwise
+    static unsigned int classFor(int size)
+    {
+        unsigned int c = 0;
+        while (c < 2 && (minSize << c) < size) c++;
+        return c;
+    }
+
+    // bilinear, wrapping like GL_REPEAT. Halving lands between texel pairs, so that case is a 2x2 box filter.
+    static void resample(const unsigned char* src, int w, int h, unsigned char* dst, int size)
+    {
+        for (int y = 0; y < size; y++) {
+            float sy = (y + 0.5f) * h / size - 0.5f;
+            int y0 = (int)std::floor(sy);
+            float fy = sy - y0;
+            int ya = (y0 % h + h) % h, yb = ((y0 + 1) % h + h) % h;
+            for (int x = 0; x < size; x++) {
+                float sx = (x + 0.5f) * w / size - 0.5f;
+                int x0 = (int)std::floor(sx);
+                float fx = sx - x0;
+                int xa = (x0 % w + w) % w, xb = ((x0 + 1) % w + w) % w;
+                const unsigned char* p00 = src + ((size_t)ya * w + xa) * 4;
+                const unsigned char* p10 = src + ((size_t)ya * w + xb) * 4;
+                const unsigned char* p01 = src + ((size_t)yb * w + xa) * 4;
+                const unsigned char* p11 = src + ((size_t)yb * w + xb) * 4;
+                unsigned char* out = dst + ((size_t)y * size + x) * 4;
+                for (int c = 0; c < 4; c++) {
+                    float top = p00[c] + (p10[c] - p00[c]) * fx;
+                    float bottom = p01[c] + (p11[c] - p01[c]) * fx;
+                    out[c] = (unsigned char)(top + (bottom - top) * fy + 0.5f);
+                }
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,146 @@
+#ifndef MEMSTATS_H
+#define MEMSTATS_H
+
+#include <GL/glew.h>
+
+#include "model.hpp"
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// What models cost: geometry the meshes keep on the CPU, their GL buffers and their textures. GPU sizes
+// are computed from what was uploaded (the driver may pad, RGB is often stored as RGBA), so they are a
+// lower bound, but a stable one that can be compared between runs.
+struct MemoryStats {
+    size_t cpuGeometry = 0;     // vertices and indices still held by the meshes
+    size_t gpuBuffers = 0;      // vertex, position and index buffers
+    size_t textures = 0;        // every mip level
+    unsigned int meshes = 0;
+    unsigned int textureCount = 0;
+
+    size_t gpu() const { return gpuBuffers + textures; }
+
+    MemoryStats& operator+=(const MemoryStats& other)
+    {
+        cpuGeometry += other.cpuGeometry;
+        gpuBuffers += other.gpuBuffers;
+        textures += other.textures;
+        meshes += other.meshes;
+        textureCount += other.textureCount;
+        return *this;
+    }
+};
+
+inline double toMegabytes(size_t bytes) { return bytes / (1024.0 * 1024.0); }
+
+// bytes of a 2D texture with its full mip chain, 0 for a texture with no storage
+inline size_t textureMemory(GLuint texture)
+{
+    if (!texture) return 0;
+    GLint w = 0, h = 0, format = 0;
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &w);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &h);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    size_t texel = format == GL_RED || format == GL_R8 ? 1 : format == GL_RGB || format == GL_RGB8 ? 3 : 4;
+    size_t bytes = 0;
+    while (w > 0 && h > 0) {
+        bytes += (size_t)w * h * texel;
+        if (w == 1 && h == 1) break;
+        w = w > 1 ? w / 2 : 1;
+        h = h > 1 ? h / 2 : 1;
+    }
+    return bytes;
+}
+
+inline MemoryStats meshMemory(const Mesh& mesh)
+{
+    MemoryStats stats;
+    stats.meshes = 1;
+    stats.cpuGeometry = mesh.vertices.capacity() * sizeof(Vertex) + mesh.indices.capacity() * sizeof(unsigned int);
+    if (mesh.VAO)
+        stats.gpuBuffers = (size_t)mesh.vertexCount * (sizeof(Vertex) + sizeof(glm::vec3)) + (size_t)mesh.indexCount * sizeof(unsigned int);
+    return stats;
+}
+
+// meshes plus the model's own textures (meshes only reference those)
+inline MemoryStats modelMemory(const Model& model)
+{
+    MemoryStats stats;
+    for (const Mesh& mesh : model.meshes)
+        stats += meshMemory(mesh);
+    for (const Texture& texture : model.textures_loaded) {
+        stats.textures += textureMemory(texture.id);
+        stats.textureCount++;
+    }
+    return stats;
+}
+
+// named models and extra GPU allocations, printed as a table with a total. With 'detail' every mesh and
+// texture gets its own line.
+class MemoryReport
+{
+public:
+    void add(const std::string& name, const Model& model)
+    {
+        entries.push_back(Entry{ name, &model, modelMemory(model) });
+        total += entries.back().stats;
+    }
+
+    // GPU memory that isn't a model (pooled buffers, texture arrays, render targets)
+    void addGpu(const std::string& name, size_t buffers, size_t textures)
+    {
+        MemoryStats stats;
+        stats.gpuBuffers = buffers;
+        stats.textures = textures;
+        entries.push_back(Entry{ name, nullptr, stats });
+        total += stats;
+    }
+
+    const MemoryStats& totals() const { return total; }
+
+    void print(std::ostream& out, bool detail = false) const
+    {
+        out << std::fixed << std::setprecision(2);
+        out << "Memory (MB)                    CPU geometry  GPU buffers     textures\n";
+        for (const Entry& entry : entries) {
+            line(out, entry.name, entry.stats);
+            if (!detail || !entry.model) continue;
+            for (size_t i = 0; i < entry.model->meshes.size(); i++)
+                line(out, "  mesh " + std::to_string(i), meshMemory(entry.model->meshes[i]));
+            for (const Texture& texture : entry.model->textures_loaded) {
+                MemoryStats stats;
+                stats.textures = textureMemory(texture.id);
+                line(out, "  " + texture.path, stats);
+            }
+        }
+        line(out, "total", total);
+        out << "  " << total.meshes << " meshes, " << total.textureCount << " textures, "
+            << toMegabytes(total.cpuGeometry) << " MB CPU, " << toMegabytes(total.gpu()) << " MB GPU\n";
+        out << std::defaultfloat << std::setprecision(6);
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        const Model* model;
+        MemoryStats stats;
+    };
+
+    std::vector<Entry> entries;
+    MemoryStats total;
+
+    static void line(std::ostream& out, const std::string& name, const MemoryStats& stats)
+    {
+        out << "  " << std::left << std::setw(28) << name.substr(0, 28) << std::right
+            << std::setw(13) << toMegabytes(stats.cpuGeometry)
+            << std::setw(13) << toMegabytes(stats.gpuBuffers)
+            << std::setw(13) << toMegabytes(stats.textures) << "\n";
+    }
+};
+
+#endif
@@ -23,6 +23,14 @@ struct Vertex {
     glm::vec2 TexCoords;
 };
 
+// axis aligned box and bounding sphere in mesh (object) space, filled in at import
+struct Bounds {
+    glm::vec3 min = glm::vec3(0.0f);
+    glm::vec3 max = glm::vec3(0.0f);
+    glm::vec3 center = glm::vec3(0.0f);
+    float radius = 0.0f;
+};
+
 struct Texture {
     unsigned int id;
     string type;
@@ -35,58 +43,137 @@ public:
     vector<Vertex>       vertices;
     vector<unsigned int> indices;
     vector<Texture>      textures;
-    unsigned int VAO;
-
-    // constructor
-    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures)
+    Bounds               bounds;
+    unsigned int VAO = 0;
+    // positions only, tightly packed, for depth only passes (pre-pass, shadow maps). Shares the EBO.
+    unsigned int depthVAO = 0;
+    // where the mesh sits in the shared buffers of the indirect renderer (indirect.hpp)
+    unsigned int firstIndex = 0;
+    unsigned int baseVertex = 0;
+    unsigned int material = 0;      // its diffuse texture's layer in the renderer's MaterialArrays
+    // sizes of the uploaded buffers, still valid after releaseGeometry()
+    unsigned int vertexCount = 0;
+    unsigned int indexCount = 0;
+
+    // constructor, upload = false keeps the mesh CPU only until upload() (import benchmarks, loading off the GL thread).
+    // The vectors are moved in. 'positions' is an optional ready position stream (import staging, model.hpp).
+    Mesh(vector<Vertex> vertices, vector<unsigned int> indices, vector<Texture> textures, Bounds bounds, bool upload = true,
+         const glm::vec3* positions = nullptr)
     {
-        this->vertices = vertices;
-        this->indices = indices;
-        this->textures = textures;
+        vertexCount = (unsigned int)vertices.size();
+        indexCount = (unsigned int)indices.size();
+        this->vertices = std::move(vertices);
+        this->indices = std::move(indices);
+        this->textures = std::move(textures);
+        this->bounds = bounds;
+        nameSamplers();
 
         // now that we have all the required data, set the vertex buffers and its attribute pointers.
-        setupMesh();
+        if (upload) setupMesh(positions);
+    }
+
+    // creates the GL buffers for a mesh constructed with upload = false, needs a current context
+    void upload(const glm::vec3* positions = nullptr)
+    {
+        if (VAO == 0) setupMesh(positions);
+    }
+
+    // frees the CPU copy of an uploaded mesh, the GPU buffers are all that draws need
+    void releaseGeometry()
+    {
+        if (VAO == 0) return;
+        vector<Vertex>().swap(vertices);
+        vector<unsigned int>().swap(indices);
+    }
+
+    // deletes the GL objects, the CPU data stays. Textures belong to the model.
+    void release()
+    {
+        if (VAO) glDeleteVertexArrays(1, &VAO);
+        if (depthVAO) glDeleteVertexArrays(1, &depthVAO);
+        if (VBO) glDeleteBuffers(1, &VBO);
+        if (EBO) glDeleteBuffers(1, &EBO);
+        if (positionVBO) glDeleteBuffers(1, &positionVBO);
+        VAO = depthVAO = VBO = EBO = positionVBO = 0;
+    }
+
+    // positions only, no textures bound. The shader must read only location 0.
+    void DrawDepth()
+    {
+        glBindVertexArray(depthVAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+    }
+
+    // same, 'instances' times. The VAO must have per instance attributes (trackgen.hpp).
+    void DrawDepthInstanced(unsigned int instances)
+    {
+        glBindVertexArray(depthVAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instances);
+        glBindVertexArray(0);
     }
 
     // render the mesh
     void Draw(Shader& shader)
     {
-        // bind appropriate textures
+        bindTextures(shader);
+
+        // draw mesh
+        glBindVertexArray(VAO);
+        glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0);
+        glBindVertexArray(0);
+
+        // always good practice to set everything back to defaults once configured.
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+    void DrawInstanced(Shader& shader, unsigned int instances)
+    {
+        bindTextures(shader);
+        glBindVertexArray(VAO);
+        glDrawElementsInstanced(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, 0, instances);
+        glBindVertexArray(0);
+        glActiveTexture(GL_TEXTURE0);
+    }
+
+private:
+    // render data 
+    unsigned int VBO = 0, EBO = 0;
+    unsigned int positionVBO = 0;
+    // sampler uniform per texture ("uDiffMap1", "uSpecMap1", ...), named once so drawing builds no strings
+    vector<string> samplers;
+
+    void nameSamplers()
+    {
         unsigned int diffuseNr = 1;
         unsigned int specularNr = 1;
-        unsigned int normalNr = 1;
+        samplers.resize(textures.size());
         for (unsigned int i = 0; i < textures.size(); i++)
         {
-            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // retrieve texture number (the N in diffuse_textureN)
-            string number;
-            string name = textures[i].type;
+            const string& name = textures[i].type;
             if (name == "uDiffMap")
-                number = std::to_string(diffuseNr++);
+                samplers[i] = name + std::to_string(diffuseNr++);
             else
-                number = std::to_string(specularNr++); // transfer unsigned int to string
+                samplers[i] = name + std::to_string(specularNr++); // transfer unsigned int to string
+        }
+    }
 
+    void bindTextures(Shader& shader)
+    {
+        // bind appropriate textures
+        for (unsigned int i = 0; i < textures.size(); i++)
+        {
+            glActiveTexture(GL_TEXTURE0 + i); // active proper texture unit before binding
             // now set the sampler to the correct texture unit
-            glUniform1i(glGetUniformLocation(shader.ID, (name + number).c_str()), i);
+            glUniform1i(glGetUniformLocation(shader.ID, samplers[i].c_str()), i);
             // and finally bind the texture
             glBindTexture(GL_TEXTURE_2D, textures[i].id);
         }
-
-        // draw mesh
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, static_cast<unsigned int>(indices.size()), GL_UNSIGNED_INT, 0);
-        glBindVertexArray(0);
-
-        // always good practice to set everything back to defaults once configured.
-        glActiveTexture(GL_TEXTURE0);
     }
 
-private:
-    // render data 
-    unsigned int VBO, EBO;
-
     // initializes all the buffer objects/arrays
-    void setupMesh()
+    void setupMesh(const glm::vec3* positions)
     {
         // create buffers/arrays
         glGenVertexArrays(1, &VAO);
@@ -114,6 +201,24 @@ private:
         // vertex texture coords
         glEnableVertexAttribArray(2);
         glVertexAttribPointer(2, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), (void*)offsetof(Vertex, TexCoords));
+
+        // depth only stream: 12 bytes per vertex instead of 32, the pre-pass fetches a third of the data
+        vector<glm::vec3> extracted;
+        if (!positions) {
+            extracted.resize(vertices.size());
+            for (size_t i = 0; i < vertices.size(); i++)
+                extracted[i] = vertices[i].Position;
+            positions = extracted.data();
+        }
+        glGenVertexArrays(1, &depthVAO);
+        glGenBuffers(1, &positionVBO);
+        glBindVertexArray(depthVAO);
+        glBindBuffer(GL_ARRAY_BUFFER, positionVBO);
+        glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(glm::vec3), positions, GL_STATIC_DRAW);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(glm::vec3), (void*)0);
+        glBindVertexArray(0);
     }
 };
 #endif
@@ -14,16 +14,30 @@
 
 #include "mesh.hpp"
 #include "shader.hpp"
+#include "frustum.hpp"
+#include "profiler.hpp"
+#include "arena.hpp"
 
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <iostream>
 #include <map>
+#include <memory>
 #include <vector>
+#include <algorithm>
 
 using namespace std;
 
+// decoded pixels of a texture that isn't on the GPU yet
+struct TextureImage {
+    string path;
+    int width = 0, height = 0, components = 0;
+    shared_ptr<unsigned char> pixels;   // stbi memory, freed with stbi_image_free
+};
+
+TextureImage decodeTexture(const char* path, const string& directory);
+unsigned int uploadTexture(const TextureImage& image, bool gamma = false);
 unsigned int TextureFromFile(const char* path, const string& directory, bool gamma = false);
 
 class Model
@@ -34,24 +48,147 @@ public:
     vector<Mesh>    meshes;
     string directory;
     bool gammaCorrection;
+    Bounds bounds;      // union of all mesh bounds, object space
 
     // constructor, expects a filepath to a 3D model.
-    Model(string const& path, bool gamma = false) : gammaCorrection(gamma)
+    // upload = false only imports and decodes on the CPU, upload() later creates the GL objects.
+    Model(string const& path, bool gamma = false, bool upload = true) : gammaCorrection(gamma), uploadOnLoad(upload)
     {
         loadModel(path);
     }
 
+    // model from meshes generated in code (trackgen.hpp), already uploaded
+    explicit Model(vector<Mesh> generated) : gammaCorrection(false)
+    {
+        meshes.swap(generated);
+        finishMeshes();
+    }
+
+    bool uploaded() const { return pendingImages.empty() && (meshes.empty() || meshes[0].VAO != 0); }
+
+    // sends meshes and decoded textures of a model loaded with upload = false to the GPU, needs a current context
+    void upload()
+    {
+        PROFILE_SCOPE("Model::upload");
+        for (size_t i = 0; i < meshes.size(); i++)
+            meshes[i].upload(i < stagedPositions.size() ? stagedPositions[i] : nullptr);
+        releaseStaging();
+
+        for (const TextureImage& image : pendingImages) {
+            unsigned int id = uploadTexture(image, gammaCorrection);
+            for (Texture& texture : textures_loaded)
+                if (texture.path == image.path) texture.id = id;
+            for (Mesh& mesh : meshes)
+                for (Texture& texture : mesh.textures)
+                    if (texture.path == image.path) texture.id = id;
+        }
+        pendingImages.clear();
+    }
+
+    // drops the CPU side vertices and indices of uploaded meshes (bounds stay), see memstats.hpp
+    void releaseGeometry()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.releaseGeometry();
+    }
+
+    // frees the meshes' buffers and the textures, for models that are dropped while the context lives on
+    void release()
+    {
+        for (Mesh& mesh : meshes)
+            mesh.release();
+        for (Texture& texture : textures_loaded)
+            if (texture.id) glDeleteTextures(1, &texture.id);
+        textures_loaded.clear();
+    }
+
     // draws the model, and thus all its meshes
     void Draw(Shader& shader)
     {
+        PROFILE_SCOPE("Model::Draw");
         for (unsigned int i = 0; i < meshes.size(); i++)
             meshes[i].Draw(shader);
     }
 
+    // draws only the meshes whose bounds touch the frustum. 'model' is the matrix that is uploaded as uM.
+    void Draw(Shader& shader, const Frustum& frustum, const glm::mat4& model, CullStats& stats)
+    {
+        PROFILE_SCOPE("Model::Draw");
+        const unsigned char* visible = cull(frustum, model, stats);
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (visible[i]) meshes[i].Draw(shader);
+    }
+
+    // depth only, through the positions only stream. 'visible' is an optional cull() result.
+    void DrawDepth(const unsigned char* visible = nullptr)
+    {
+        PROFILE_SCOPE("Model::DrawDepth");
+        for (unsigned int i = 0; i < meshes.size(); i++)
+            if (!visible || visible[i]) meshes[i].DrawDepth();
+    }
+
+    // per mesh visibility (1 = draw) for the given model matrix. The returned array belongs to the model
+    // and stays valid until the next cull call.
+    const unsigned char* cull(const Frustum& frustum, const glm::mat4& model, CullStats& stats)
+    {
+        unsigned int count = (unsigned int)meshes.size();
+        float radiusScale = maxAxisScale(model);
+
+        // whole model first, most of the time this is enough to throw everything away
+        glm::vec3 modelCenter = glm::vec3(model * glm::vec4(bounds.center, 1.0f));
+        if (!frustum.testSphere(modelCenter, bounds.radius * radiusScale)) {
+            std::fill(cullVisible.begin(), cullVisible.end(), 0);
+            stats.culled += count;
+            return cullVisible.data();
+        }
+
+        // world space spheres of every mesh, tested 4 at a time
+        for (unsigned int i = 0; i < count; i++) {
+            glm::vec3 center = glm::vec3(model * glm::vec4(meshes[i].bounds.center, 1.0f));
+            cullX[i] = center.x;
+            cullY[i] = center.y;
+            cullZ[i] = center.z;
+            cullR[i] = meshes[i].bounds.radius * radiusScale;
+        }
+        frustum.testSpheres(cullX.data(), cullY.data(), cullZ.data(), cullR.data(), (int)count, cullVisible.data());
+
+        for (unsigned int i = 0; i < count; i++) {
+            // sphere passed, the box is tighter for long thin meshes (rails, belts)
+            if (cullVisible[i]) {
+                glm::vec3 center, extents;
+                transformBox(model, meshes[i].bounds.min, meshes[i].bounds.max, center, extents);
+                cullVisible[i] = frustum.testBox(center, extents) ? 1 : 0;
+            }
+
+            if (cullVisible[i]) stats.drawn++;
+            else stats.culled++;
+        }
+        return cullVisible.data();
+    }
+
 private:
+    bool uploadOnLoad = true;
+    vector<TextureImage> pendingImages;     // decoded, waiting for upload()
+
+    // import staging: the position only stream of every mesh, written while the vertices are read.
+    // One block sized from the aiScene counts, freed in one go once the meshes are on the GPU.
+    Arena staging;
+    vector<glm::vec3*> stagedPositions;     // per mesh, into 'staging'
+
+    void releaseStaging()
+    {
+        staging.release();
+        vector<glm::vec3*>().swap(stagedPositions);
+    }
+
+    // scratch arrays for the culling pass, sized once after loading so Draw doesn't allocate
+    vector<float> cullX, cullY, cullZ, cullR;
+    vector<unsigned char> cullVisible;
+
     // loads a model with supported ASSIMP extensions from file and stores the resulting meshes in the meshes vector.
     void loadModel(string const& path)
     {
+        PROFILE_SCOPE("Model::loadModel");
         // read file via ASSIMP
         Assimp::Importer importer;
         const aiScene* scene = importer.ReadFile(path, aiProcess_Triangulate | aiProcess_GenSmoothNormals | aiProcess_FlipUVs | aiProcess_CalcTangentSpace);
@@ -64,8 +201,51 @@ private:
         // retrieve the directory path of the filepath
         directory = path.substr(0, path.find_last_of('/'));
 
+        // a mesh can be referenced by several nodes, count the references so nothing grows while importing
+        size_t meshCount = 0, vertexCount = 0;
+        countMeshes(scene->mRootNode, scene, meshCount, vertexCount);
+        meshes.reserve(meshCount);
+        stagedPositions.reserve(meshCount);
+        staging.reserve(vertexCount * sizeof(glm::vec3) + meshCount * alignof(glm::vec3));
+
         // process ASSIMP's root node recursively
         processNode(scene->mRootNode, scene);
+
+        finishMeshes();
+        if (uploadOnLoad) releaseStaging();
+    }
+
+    // model bounds and culling scratch space, once the meshes are in
+    void finishMeshes()
+    {
+        // bounds of the whole model from the mesh boxes
+        if (!meshes.empty()) {
+            bounds.min = meshes[0].bounds.min;
+            bounds.max = meshes[0].bounds.max;
+            for (unsigned int i = 1; i < meshes.size(); i++) {
+                bounds.min = glm::min(bounds.min, meshes[i].bounds.min);
+                bounds.max = glm::max(bounds.max, meshes[i].bounds.max);
+            }
+            bounds.center = (bounds.min + bounds.max) * 0.5f;
+            bounds.radius = 0.0f;
+            for (unsigned int i = 0; i < meshes.size(); i++)
+                bounds.radius = glm::max(bounds.radius, glm::distance(bounds.center, meshes[i].bounds.center) + meshes[i].bounds.radius);
+        }
+
+        cullX.resize(meshes.size());
+        cullY.resize(meshes.size());
+        cullZ.resize(meshes.size());
+        cullR.resize(meshes.size());
+        cullVisible.resize(meshes.size());
+    }
+
+    void countMeshes(aiNode* node, const aiScene* scene, size_t& meshCount, size_t& vertexCount)
+    {
+        for (unsigned int i = 0; i < node->mNumMeshes; i++)
+            vertexCount += scene->mMeshes[node->mMeshes[i]]->mNumVertices;
+        meshCount += node->mNumMeshes;
+        for (unsigned int i = 0; i < node->mNumChildren; i++)
+            countMeshes(node->mChildren[i], scene, meshCount, vertexCount);
     }
 
     // processes a node in a recursive fashion. Processes each individual mesh located at the node and repeats this process on its children nodes (if any).
@@ -89,21 +269,34 @@ private:
 
     Mesh processMesh(aiMesh* mesh, const aiScene* scene)
     {
-        // data to fill
-        vector<Vertex> vertices;
+        // data to fill, sized from Assimp's counts and written in place (moved into the Mesh, never regrown)
+        vector<Vertex> vertices(mesh->mNumVertices);
         vector<unsigned int> indices;
         vector<Texture> textures;
+        Bounds bounds;
+        glm::vec3* positions = staging.allocate<glm::vec3>(mesh->mNumVertices);
+        stagedPositions.push_back(positions);
 
         // walk through each of the mesh's vertices
         for (unsigned int i = 0; i < mesh->mNumVertices; i++)
         {
-            Vertex vertex;
+            Vertex& vertex = vertices[i];
             glm::vec3 vector; // we declare a placeholder vector since assimp uses its own vector class that doesn't directly convert to glm's vec3 class so we transfer the data to this placeholder glm::vec3 first.
             // positions
             vector.x = mesh->mVertices[i].x;
             vector.y = mesh->mVertices[i].y;
             vector.z = mesh->mVertices[i].z;
             vertex.Position = vector;
+            positions[i] = vector;
+            // grow the box while we are here anyway
+            if (i == 0) {
+                bounds.min = vector;
+                bounds.max = vector;
+            }
+            else {
+                bounds.min = glm::min(bounds.min, vector);
+                bounds.max = glm::max(bounds.max, vector);
+            }
             // normals
             if (mesh->HasNormals())
             {
@@ -112,6 +305,8 @@ private:
                 vector.z = mesh->mNormals[i].z;
                 vertex.Normal = vector;
             }
+            else
+                vertex.Normal = glm::vec3(0.0f);
             // texture coordinates
             if (mesh->mTextureCoords[0]) // does the mesh contain texture coordinates?
             {
@@ -124,16 +319,24 @@ private:
             }
             else
                 vertex.TexCoords = glm::vec2(0.0f, 0.0f);
-
-            vertices.push_back(vertex);
         }
+        // sphere around the box center, radius is the farthest vertex (tighter than half the box diagonal)
+        bounds.center = (bounds.min + bounds.max) * 0.5f;
+        for (unsigned int i = 0; i < vertices.size(); i++)
+            bounds.radius = glm::max(bounds.radius, glm::distance(bounds.center, positions[i]));
         // now wak through each of the mesh's faces (a face is a mesh its triangle) and retrieve the corresponding vertex indices.
+        // Triangulated faces are mostly 3 indices, points and lines less, so count first and allocate once.
+        size_t indexCount = 0;
+        for (unsigned int i = 0; i < mesh->mNumFaces; i++)
+            indexCount += mesh->mFaces[i].mNumIndices;
+        indices.resize(indexCount);
+        unsigned int* index = indices.data();
         for (unsigned int i = 0; i < mesh->mNumFaces; i++)
         {
-            aiFace face = mesh->mFaces[i];
+            const aiFace& face = mesh->mFaces[i];
             // retrieve all indices of the face and store them in the indices vector
             for (unsigned int j = 0; j < face.mNumIndices; j++)
-                indices.push_back(face.mIndices[j]);
+                *index++ = face.mIndices[j];
         }
         // process materials
         aiMaterial* material = scene->mMaterials[mesh->mMaterialIndex];
@@ -141,23 +344,21 @@ private:
         // as 'texture_diffuseN' where N is a sequential number ranging from 1 to MAX_SAMPLER_NUMBER. 
         // Same applies to other texture as the following list summarizes:
         // diffuse: texture_diffuseN
+        textures.reserve(material->GetTextureCount(aiTextureType_DIFFUSE) + material->GetTextureCount(aiTextureType_SPECULAR));
 
         // 1. diffuse maps
-        vector<Texture> diffuseMaps = loadMaterialTextures(material, aiTextureType_DIFFUSE, "uDiffMap");
-        textures.insert(textures.end(), diffuseMaps.begin(), diffuseMaps.end());
+        loadMaterialTextures(material, aiTextureType_DIFFUSE, "uDiffMap", textures);
         // 2. specular maps
-        vector<Texture> specularMaps = loadMaterialTextures(material, aiTextureType_SPECULAR, "uSpecMap");
-        textures.insert(textures.end(), specularMaps.begin(), specularMaps.end());
+        loadMaterialTextures(material, aiTextureType_SPECULAR, "uSpecMap", textures);
 
         // return a mesh object created from the extracted mesh data
-        return Mesh(vertices, indices, textures);
+        return Mesh(std::move(vertices), std::move(indices), std::move(textures), bounds, uploadOnLoad, positions);
     }
 
     // checks all material textures of a given type and loads the textures if they're not loaded yet.
-    // the required info is returned as a Texture struct.
-    vector<Texture> loadMaterialTextures(aiMaterial* mat, aiTextureType type, string typeName)
+    // the required info is appended to 'textures' as Texture structs.
+    void loadMaterialTextures(aiMaterial* mat, aiTextureType type, const char* typeName, vector<Texture>& textures)
     {
-        vector<Texture> textures;
         for (unsigned int i = 0; i < mat->GetTextureCount(type); i++)
         {
             aiString str;
@@ -176,57 +377,72 @@ private:
             if (!skip)
             {   // if texture hasn't been loaded already, load it
                 Texture texture;
-                texture.id = TextureFromFile(str.C_Str(), this->directory);
+                if (uploadOnLoad)
+                    texture.id = TextureFromFile(str.C_Str(), this->directory);
+                else {
+                    texture.id = 0;
+                    TextureImage image = decodeTexture(str.C_Str(), this->directory);
+                    if (image.pixels) pendingImages.push_back(std::move(image));
+                }
                 texture.type = typeName;
                 texture.path = str.C_Str();
                 textures.push_back(texture);
                 textures_loaded.push_back(texture);  // store it as texture loaded for entire model, to ensure we won't unnecessary load duplicate textures.
             }
         }
-        return textures;
     }
 };
 
 
 
-unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+TextureImage decodeTexture(const char* path, const string& directory)
 {
+    PROFILE_SCOPE("texture decode");
     string filename = string(path);
     filename = directory + '/' + filename;
 
+    TextureImage image;
+    image.path = path;
+    unsigned char* data = stbi_load(filename.c_str(), &image.width, &image.height, &image.components, 0);
+    if (data)
+        image.pixels = shared_ptr<unsigned char>(data, stbi_image_free);
+    else
+        std::cout << "Texture failed to load at path: " << path << std::endl;
+    return image;
+}
+
+// creates the GL texture, returns a texture with no storage if the image didn't decode
+unsigned int uploadTexture(const TextureImage& image, bool gamma)
+{
+    PROFILE_SCOPE("texture upload");
     unsigned int textureID;
     glGenTextures(1, &textureID);
+    if (!image.pixels) return textureID;
 
-    int width, height, nrComponents;
-    unsigned char* data = stbi_load(filename.c_str(), &width, &height, &nrComponents, 0);
-    if (data)
-    {
-        GLenum format;
-        if (nrComponents == 1)
-            format = GL_RED;
-        else if (nrComponents == 3)
-            format = GL_RGB;
-        else if (nrComponents == 4)
-            format = GL_RGBA;
-
-        glBindTexture(GL_TEXTURE_2D, textureID);
-        glTexImage2D(GL_TEXTURE_2D, 0, format, width, height, 0, format, GL_UNSIGNED_BYTE, data);
-        glGenerateMipmap(GL_TEXTURE_2D);
+    GLenum format = GL_RGB;
+    if (image.components == 1)
+        format = GL_RED;
+    else if (image.components == 3)
+        format = GL_RGB;
+    else if (image.components == 4)
+        format = GL_RGBA;
 
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glBindTexture(GL_TEXTURE_2D, textureID);
+    glTexImage2D(GL_TEXTURE_2D, 0, format, image.width, image.height, 0, format, GL_UNSIGNED_BYTE, image.pixels.get());
+    glGenerateMipmap(GL_TEXTURE_2D);
 
-        stbi_image_free(data);
-    }
-    else
-    {
-        std::cout << "Texture failed to load at path: " << path << std::endl;
-        stbi_image_free(data);
-    }
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
     return textureID;
 }
+
+unsigned int TextureFromFile(const char* path, const string& directory, bool gamma)
+{
+    PROFILE_SCOPE("TextureFromFile");
+    return uploadTexture(decodeTexture(path, directory), gamma);
+}
 #endif
 
@@ -0,0 +1,161 @@
+#ifndef OCTREE_H
+#define OCTREE_H
+
+#include <glm/glm.hpp>
+
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <vector>
+
+// Loose octree over static world space boxes (scene props, track instances).
+//
+// Every node's loose bounds are twice its cell, so an item only has to have its center inside a cell and
+// fit the cell size to live there; it is stored in exactly one node and never split. Items are placed at
+// the deepest level whose cell is at least as big as their radius. Nodes and item lists are flat arrays
+// built once in build(); queries walk the tree with a fixed stack and don't allocate beyond the output.
+class LooseOctree
+{
+public:
+    static const int maxDepth = 8;
+
+    // boxes are indexed by item id, the id is what queries return
+    void build(const std::vector<glm::vec3>& boxMin, const std::vector<glm::vec3>& boxMax, int depthLimit = 6)
+    {
+        nodes.clear();
+        items.clear();
+        itemMin = boxMin;
+        itemMax = boxMax;
+        depth = std::max(0, std::min(depthLimit, maxDepth - 1));
+        if (boxMin.empty()) return;
+
+        // root cell: cube around everything
+        glm::vec3 lo = boxMin[0], hi = boxMax[0];
+        for (size_t i = 1; i < boxMin.size(); i++) {
+            lo = glm::min(lo, boxMin[i]);
+            hi = glm::max(hi, boxMax[i]);
+        }
+        glm::vec3 size = hi - lo;
+        Node root;
+        root.center = (lo + hi) * 0.5f;
+        root.half = 0.5f * std::max(size.x, std::max(size.y, size.z)) + 1e-3f;
+        nodes.push_back(root);
+
+        std::vector<int> itemNode(boxMin.size());
+        for (size_t i = 0; i < boxMin.size(); i++)
+            itemNode[i] = insert(boxMin[i], boxMax[i]);
+
+        // group item ids by node (counting sort) so a node's items are contiguous
+        std::vector<unsigned int> counts(nodes.size() + 1, 0);
+        for (int n : itemNode) counts[n + 1]++;
+        for (size_t n = 0; n < nodes.size(); n++) {
+            counts[n + 1] += counts[n];
+            nodes[n].firstItem = counts[n];
+            nodes[n].itemCount = counts[n + 1] - counts[n];
+        }
+        items.resize(boxMin.size());
+        for (size_t i = 0; i < boxMin.size(); i++)
+            items[counts[itemNode[i]]++] = (unsigned int)i;
+    }
+
+    // ids of items whose box touches the frustum
+    void queryFrustum(const Frustum& frustum, std::vector<unsigned int>& out) const
+    {
+        out.clear();
+        if (nodes.empty()) return;
+
+        int stack[maxDepth * 8];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            if (!frustum.testBox(node.center, glm::vec3(2.0f * node.half))) continue;
+
+            for (unsigned int k = 0; k < node.itemCount; k++) {
+                unsigned int id = items[node.firstItem + k];
+                if (frustum.testBox((itemMin[id] + itemMax[id]) * 0.5f, (itemMax[id] - itemMin[id]) * 0.5f))
+                    out.push_back(id);
+            }
+            for (int c = 0; c < 8; c++)
+                if (node.children[c] >= 0) stack[top++] = node.children[c];
+        }
+    }
+
+    // ids of items whose box is within 'radius' of 'point'
+    void querySphere(const glm::vec3& point, float radius, std::vector<unsigned int>& out) const
+    {
+        out.clear();
+        if (nodes.empty()) return;
+
+        int stack[maxDepth * 8];
+        int top = 0;
+        stack[top++] = 0;
+        while (top > 0) {
+            const Node& node = nodes[stack[--top]];
+            glm::vec3 loose(2.0f * node.half);
+            if (!sphereTouchesBox(point, radius, node.center - loose, node.center + loose)) continue;
+
+            for (unsigned int k = 0; k < node.itemCount; k++) {
+                unsigned int id = items[node.firstItem + k];
+                if (sphereTouchesBox(point, radius, itemMin[id], itemMax[id]))
+                    out.push_back(id);
+            }
+            for (int c = 0; c < 8; c++)
+                if (node.children[c] >= 0) stack[top++] = node.children[c];
+        }
+    }
+
+    unsigned int nodeCount() const { return (unsigned int)nodes.size(); }
+
+    // root cell, the whole scene fits in it
+    glm::vec3 center() const { return nodes.empty() ? glm::vec3(0.0f) : nodes[0].center; }
+    float halfSize() const { return nodes.empty() ? 0.0f : nodes[0].half; }
+
+private:
+    struct Node {
+        glm::vec3 center;
+        float half;             // half size of the cell, loose bounds are center +- 2 * half
+        int children[8] = { -1, -1, -1, -1, -1, -1, -1, -1 };
+        unsigned int firstItem = 0, itemCount = 0;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<unsigned int> items;    // item ids grouped by node
+    std::vector<glm::vec3> itemMin, itemMax;
+    int depth = 6;
+
+    int insert(const glm::vec3& lo, const glm::vec3& hi)
+    {
+        glm::vec3 c = (lo + hi) * 0.5f;
+        glm::vec3 e = (hi - lo) * 0.5f;
+        float radius = std::max(e.x, std::max(e.y, e.z));
+
+        int n = 0;
+        for (int d = 0; d < depth; d++) {
+            float childHalf = nodes[n].half * 0.5f;
+            if (radius > childHalf) break;      // wouldn't fit the child's loose bounds
+
+            int octant = (c.x > nodes[n].center.x ? 1 : 0) | (c.y > nodes[n].center.y ? 2 : 0) | (c.z > nodes[n].center.z ? 4 : 0);
+            if (nodes[n].children[octant] < 0) {
+                Node child;
+                child.half = childHalf;
+                child.center = nodes[n].center + glm::vec3(octant & 1 ? childHalf : -childHalf,
+                                                           octant & 2 ? childHalf : -childHalf,
+                                                           octant & 4 ? childHalf : -childHalf);
+                nodes[n].children[octant] = (int)nodes.size();
+                nodes.push_back(child);     // may reallocate, only indices are kept
+            }
+            n = nodes[n].children[octant];
+        }
+        return n;
+    }
+
+    static bool sphereTouchesBox(const glm::vec3& p, float r, const glm::vec3& lo, const glm::vec3& hi)
+    {
+        glm::vec3 q = glm::clamp(p, lo, hi);
+        glm::vec3 d = p - q;
+        return glm::dot(d, d) <= r * r;
+    }
+};
+
+#endif
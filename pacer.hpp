@@ -0,0 +1,228 @@
+#ifndef PACER_H
+#define PACER_H
+
+#include <GLFW/glfw3.h>
+
+#include <algorithm>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#pragma comment(lib, "winmm.lib")
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002
+#endif
+#else
+#include <time.h>
+#endif
+
+// process cpu time in seconds (all threads, user + kernel)
+inline double processCpuSeconds()
+{
+#ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user);
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime; k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;   u.HighPart = user.dwHighDateTime;
+    return (double)(k.QuadPart + u.QuadPart) * 1e-7;
+#else
+    timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+#endif
+}
+
+// keeps the main loop at a target rate without burning a core:
+// sleeps until shortly before the deadline and spins only the last few hundred microseconds.
+class FramePacer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    FramePacer(double targetRate = 75.0, bool vsync = false)
+    {
+#ifdef _WIN32
+        timeBeginPeriod(1);
+        timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+        if (!timer) timer = CreateWaitableTimerW(NULL, TRUE, NULL);
+#endif
+        frameTimes.assign(historySize, 0.0f);
+        cpuTimes.assign(historySize, 0.0f);
+        scratch.reserve(historySize);
+        setTargetRate(targetRate);
+        vsyncEnabled = vsync;
+        reset();
+    }
+
+    ~FramePacer()
+    {
+#ifdef _WIN32
+        if (timer) CloseHandle(timer);
+        timeEndPeriod(1);
+#endif
+    }
+
+    // 0 or less means unlimited (only vsync, if on, limits the rate)
+    void setTargetRate(double rate)
+    {
+        targetRate = rate;
+        period = rate > 0.0 ? std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / rate)) : Clock::duration::zero();
+    }
+
+    double getTargetRate() const { return targetRate; }
+
+    // needs a current context
+    void setVsync(bool on)
+    {
+        vsyncEnabled = on;
+        glfwSwapInterval(on ? 1 : 0);
+    }
+
+    bool getVsync() const { return vsyncEnabled; }
+
+    void reset()
+    {
+        lastFrame = Clock::now();
+        deadline = lastFrame + period;
+        lastCpu = processCpuSeconds();
+        sampleCount = 0;
+        missedFrames = 0;
+    }
+
+    // call once per frame after swap. Blocks until the next frame should start and records the frame stats.
+    void waitForNextFrame()
+    {
+        if (period > Clock::duration::zero()) {
+            Clock::time_point now = Clock::now();
+
+            if (now > deadline + period) {
+                // missed by more than a whole frame, don't try to catch up with a burst of short frames
+                missedFrames++;
+                deadline = now;
+            }
+            else if (now > deadline) {
+                missedFrames++;
+            }
+            else {
+                // sleep the bulk of the wait, keep a margin for the timer's wake up latency
+                Clock::duration sleepFor = (deadline - now) - spinMargin;
+                if (sleepFor > Clock::duration::zero()) {
+                    Clock::time_point before = Clock::now();
+                    sleepPrecise(sleepFor);
+                    Clock::duration overshoot = (Clock::now() - before) - sleepFor;
+                    adaptSpinMargin(overshoot);
+                }
+                while (Clock::now() < deadline) {
+                    std::this_thread::yield();
+                }
+            }
+            deadline += period;
+        }
+
+        Clock::time_point now = Clock::now();
+        double cpu = processCpuSeconds();
+        record((float)std::chrono::duration<double>(now - lastFrame).count(), (float)(cpu - lastCpu));
+        lastFrame = now;
+        lastCpu = cpu;
+    }
+
+    // frame time percentiles and cpu use over the recorded history
+    void report(std::ostream& out)
+    {
+        unsigned int n = std::min(sampleCount, (unsigned int)historySize);
+        if (n == 0) return;
+
+        scratch.assign(frameTimes.begin(), frameTimes.begin() + n);
+        std::sort(scratch.begin(), scratch.end());
+
+        double sum = 0.0, cpuSum = 0.0;
+        for (unsigned int i = 0; i < n; i++) {
+            sum += frameTimes[i];
+            cpuSum += cpuTimes[i];
+        }
+        double avg = sum / n;
+
+        out << "Frame time (last " << n << "): avg " << avg * 1000.0 << " ms"
+            << ", p50 " << percentile(0.50) * 1000.0
+            << ", p95 " << percentile(0.95) * 1000.0
+            << ", p99 " << percentile(0.99) * 1000.0
+            << ", max " << scratch[n - 1] * 1000.0 << " ms"
+            << ", missed " << missedFrames
+            << " | CPU " << cpuSum / n * 1000.0 << " ms/frame (" << (sum > 0.0 ? cpuSum / sum * 100.0 : 0.0) << "%)"
+            << " | target " << targetRate << " Hz" << (vsyncEnabled ? ", vsync" : "") << "\n";
+    }
+
+private:
+    static const unsigned int historySize = 1024;
+
+    double targetRate = 75.0;
+    bool vsyncEnabled = false;
+    Clock::duration period;
+    Clock::time_point deadline;
+    Clock::time_point lastFrame;
+    double lastCpu = 0.0;
+
+    // spin only this long before the deadline, grows if the OS wakes us up late
+    Clock::duration spinMargin = std::chrono::microseconds(500);
+
+    // ring buffers of frame time and cpu time (seconds)
+    std::vector<float> frameTimes;
+    std::vector<float> cpuTimes;
+    std::vector<float> scratch;
+    unsigned int sampleCount = 0;
+    unsigned int missedFrames = 0;
+
+#ifdef _WIN32
+    HANDLE timer = NULL;
+#endif
+
+    void record(float frameTime, float cpuTime)
+    {
+        frameTimes[sampleCount % historySize] = frameTime;
+        cpuTimes[sampleCount % historySize] = cpuTime;
+        sampleCount++;
+    }
+
+    // expects 'scratch' to be sorted
+    float percentile(double p) const
+    {
+        size_t i = (size_t)(p * (scratch.size() - 1) + 0.5);
+        return scratch[i];
+    }
+
+    void adaptSpinMargin(Clock::duration overshoot)
+    {
+        // follow the worst recent wake up latency, decay slowly, stay within 200us..2ms
+        Clock::duration target = overshoot + overshoot / 2;
+        if (target > spinMargin) spinMargin = target;
+        else spinMargin -= (spinMargin - target) / 16;
+
+        spinMargin = std::max<Clock::duration>(spinMargin, std::chrono::microseconds(200));
+        spinMargin = std::min<Clock::duration>(spinMargin, std::chrono::milliseconds(2));
+    }
+
+    void sleepPrecise(Clock::duration d)
+    {
+#ifdef _WIN32
+        if (timer) {
+            LARGE_INTEGER due;
+            // relative time in 100ns units
+            due.QuadPart = -(LONGLONG)(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count() / 100);
+            if (SetWaitableTimer(timer, &due, 0, NULL, NULL, FALSE)) {
+                WaitForSingleObject(timer, INFINITE);
+                return;
+            }
+        }
+#endif
+        std::this_thread::sleep_for(d);
+    }
+};
+
+#endif
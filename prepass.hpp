@@ -0,0 +1,111 @@
+#ifndef PREPASS_H
+#define PREPASS_H
+
+#include <GL/glew.h>
+
+// Depth pre-pass: the scene is first drawn depth only (basic.vert with DEPTH_ONLY, Mesh::DrawDepth), then
+// the colour pass runs with GL_EQUAL and depth writes off, so basic.frag shades each pixel once no matter
+// how many passengers, seats and belts overlap there. basic.vert declares gl_Position invariant so both
+// passes produce the same depth.
+
+// depth only pass: no colour writes, depth test and writes on
+inline void beginDepthPrepass()
+{
+    glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+// colour pass over the pre-pass depth: only the front surface passes
+inline void beginEqualDepthPass()
+{
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+    glDepthMask(GL_FALSE);
+    glDepthFunc(GL_EQUAL);
+}
+
+inline void endDepthPrepass()
+{
+    glDepthMask(GL_TRUE);
+    glDepthFunc(GL_LESS);
+}
+
+// Fragments that passed the depth test in the colour pass, i.e. how often basic.frag ran, from
+// GL_SAMPLES_PASSED queries read back a few frames late. Divided by the pixel count it is the average
+// overdraw the pre-pass is meant to bring down to ~1.
+class FragmentCounter
+{
+public:
+    void create()
+    {
+        glGenQueries(ringSize, queries);
+        created = true;
+    }
+
+    void release()
+    {
+        if (!created) return;
+        glDeleteQueries(ringSize, queries);
+        created = false;
+    }
+
+    void begin()
+    {
+        if (!created || pending[next]) return;
+        GLint viewport[4];
+        glGetIntegerv(GL_VIEWPORT, viewport);
+        pixels[next] = (double)viewport[2] * viewport[3];
+        glBeginQuery(GL_SAMPLES_PASSED, queries[next]);
+        active = true;
+    }
+
+    void end()
+    {
+        if (!active) return;
+        glEndQuery(GL_SAMPLES_PASSED);
+        pending[next] = true;
+        active = false;
+        next = (next + 1) % ringSize;
+    }
+
+    void collect()
+    {
+        if (!created) return;
+        for (int i = 0; i < ringSize; i++) {
+            if (!pending[i]) continue;
+            GLint available = 0;
+            glGetQueryObjectiv(queries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;
+
+            GLuint64 samples = 0;
+            glGetQueryObjectui64v(queries[i], GL_QUERY_RESULT, &samples);
+            if (pixels[i] > 0.0) {
+                perPixelSum += samples / pixels[i];
+                frames++;
+            }
+            pending[i] = false;
+        }
+    }
+
+    // average shaded fragments per pixel since the last call, -1 if nothing was measured
+    double takeAverage()
+    {
+        double average = frames ? perPixelSum / frames : -1.0;
+        perPixelSum = 0.0;
+        frames = 0;
+        return average;
+    }
+
+private:
+    static const int ringSize = 8;
+    bool created = false;
+    bool active = false;
+    int next = 0;
+    GLuint queries[ringSize] = {};
+    bool pending[ringSize] = {};
+    double pixels[ringSize] = {};
+    double perPixelSum = 0.0;
+    unsigned int frames = 0;
+};
+
+#endif
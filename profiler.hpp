@@ -0,0 +1,276 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Scoped CPU/GPU profiler with Chrome trace-event export (open the file in chrome://tracing or ui.perfetto.dev).
+//
+//   PROFILE_SCOPE("physics");        cpu span until the end of the block
+//   PROFILE_GPU_SCOPE("scene");      GL_TIME_ELAPSED query around the block (not nestable, inner ones are skipped)
+//   ProfileScope s("name"); ... s.end();   same, for spans that don't match a block
+//
+// Nothing is recorded until Profiler::setEnabled(true); a disabled scope costs one branch.
+// Define PROFILER_DISABLED to compile all markers out, the explicit ProfileScope/GpuProfileScope ones included.
+
+struct ProfileEvent {
+    const char* name;       // must be a string literal / outlive the profiler
+    int64_t start;          // ns since profiler start
+    int64_t duration;       // ns
+};
+
+// one ring buffer per thread, old events are overwritten when it is full
+struct ProfileThreadBuffer {
+    std::vector<ProfileEvent> events;
+    uint64_t written = 0;
+    unsigned int threadId = 0;
+};
+
+class Profiler
+{
+public:
+    static const unsigned int ringSize = 1 << 16;
+    static const unsigned int gpuQueryCount = 64;
+    static const unsigned int gpuThreadId = 1000;  // separate row in the trace
+
+    static Profiler& get()
+    {
+        static Profiler instance;
+        return instance;
+    }
+
+    static bool enabled() { return get().isEnabled; }
+
+    void setEnabled(bool on) { isEnabled = on; }
+
+    // GPU timing needs a context, call once after glewInit
+    void enableGpu()
+    {
+        if (!GLEW_ARB_timer_query && !GLEW_VERSION_3_3) return;
+        gpuQueries.resize(gpuQueryCount);
+        gpuPending.resize(gpuQueryCount);
+        glGenQueries(gpuQueryCount, gpuQueries.data());
+        gpuEnabled = true;
+    }
+
+    int64_t now() const
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+    }
+
+    void record(const char* name, int64_t start, int64_t end)
+    {
+        ProfileThreadBuffer& buffer = threadBuffer();
+        ProfileEvent& e = buffer.events[buffer.written % ringSize];
+        e.name = name;
+        e.start = start;
+        e.duration = end - start;
+        buffer.written++;
+    }
+
+    // --- gpu spans ---
+
+    bool beginGpu(const char* name)
+    {
+        if (!gpuEnabled || gpuActive) return false;
+        GpuSpan& span = gpuPending[gpuNext];
+        if (span.name) return false;  // every query still in flight, drop this one
+        span.name = name;
+        span.cpuStart = now();
+        glBeginQuery(GL_TIME_ELAPSED, gpuQueries[gpuNext]);
+        gpuActive = true;
+        return true;
+    }
+
+    void endGpu()
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        gpuActive = false;
+        gpuNext = (gpuNext + 1) % gpuQueryCount;
+    }
+
+    // reads back finished queries without stalling, call once per frame
+    void collectGpu()
+    {
+        if (!gpuEnabled) return;
+        for (unsigned int i = 0; i < gpuQueryCount; i++) {
+            GpuSpan& span = gpuPending[i];
+            if (!span.name || (gpuActive && i == gpuNext)) continue;
+
+            GLint available = 0;
+            glGetQueryObjectiv(gpuQueries[i], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) continue;
+
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(gpuQueries[i], GL_QUERY_RESULT, &elapsed);
+            // only the duration is known, the span is drawn from the moment it was submitted
+            gpuEvents[gpuWritten % ringSize] = { span.name, span.cpuStart, (int64_t)elapsed };
+            gpuWritten++;
+            span.name = nullptr;
+        }
+    }
+
+    // --- export ---
+
+    bool writeChromeTrace(const std::string& path)
+    {
+        std::ofstream out(path);
+        if (!out.is_open()) {
+            std::cout << "ERROR::PROFILER:: can't write " << path << std::endl;
+            return false;
+        }
+
+        out << "{\"traceEvents\":[\n";
+        bool first = true;
+
+        std::lock_guard<std::mutex> lock(registryMutex);
+        for (ProfileThreadBuffer* buffer : buffers)
+            writeEvents(out, buffer->events, buffer->written, buffer->threadId, first);
+        writeEvents(out, gpuEvents, gpuWritten, gpuThreadId, first);
+
+        out << "\n],\"displayTimeUnit\":\"ms\"}\n";
+        std::cout << "Profiler trace written to " << path << std::endl;
+        return true;
+    }
+
+private:
+    struct GpuSpan {
+        const char* name = nullptr;
+        int64_t cpuStart = 0;
+    };
+
+    bool isEnabled = false;
+    std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    std::mutex registryMutex;
+    std::vector<ProfileThreadBuffer*> buffers;
+
+    bool gpuEnabled = false;
+    bool gpuActive = false;
+    unsigned int gpuNext = 0;
+    std::vector<GLuint> gpuQueries;
+    std::vector<GpuSpan> gpuPending;
+    std::vector<ProfileEvent> gpuEvents = std::vector<ProfileEvent>(ringSize);
+    uint64_t gpuWritten = 0;
+
+    Profiler() {}
+
+    ProfileThreadBuffer& threadBuffer()
+    {
+        // buffers live until exit so the trace can still be written after a worker thread is gone
+        thread_local ProfileThreadBuffer* buffer = nullptr;
+        if (!buffer) {
+            buffer = new ProfileThreadBuffer();
+            buffer->events.resize(ringSize);
+            std::lock_guard<std::mutex> lock(registryMutex);
+            buffer->threadId = (unsigned int)buffers.size();
+            buffers.push_back(buffer);
+        }
+        return *buffer;
+    }
+
+    static void writeEvents(std::ofstream& out, const std::vector<ProfileEvent>& events, uint64_t written, unsigned int threadId, bool& first)
+    {
+        uint64_t begin = written > ringSize ? written - ringSize : 0;
+        // trace-event timestamps are microseconds, fixed with ns digits (the default 6 significant digits round a
+        // timestamp to 10 us after the first second)
+        std::ios::fmtflags flags = out.flags();
+        std::streamsize precision = out.precision();
+        out << std::fixed << std::setprecision(3);
+        for (uint64_t i = begin; i < written; i++) {
+            const ProfileEvent& e = events[i % ringSize];
+            if (!first) out << ",\n";
+            first = false;
+            out << "{\"name\":\"" << e.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << threadId
+                << ",\"ts\":" << e.start / 1000.0 << ",\"dur\":" << e.duration / 1000.0 << "}";
+        }
+        out.flags(flags);
+        out.precision(precision);
+    }
+};
+
+#ifndef PROFILER_DISABLED
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name) : name(name), start(-1)
+    {
+        if (Profiler::enabled()) start = Profiler::get().now();
+    }
+
+    ~ProfileScope()
+    {
+        end();
+    }
+
+    // closes the span early, for phases that don't line up with a block
+    void end()
+    {
+        if (start >= 0) Profiler::get().record(name, start, Profiler::get().now());
+        start = -1;
+    }
+
+private:
+    const char* name;
+    int64_t start;
+};
+
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope(const char* name) : active(false)
+    {
+        if (Profiler::enabled()) active = Profiler::get().beginGpu(name);
+    }
+
+    ~GpuProfileScope()
+    {
+        end();
+    }
+
+    void end()
+    {
+        if (active) Profiler::get().endGpu();
+        active = false;
+    }
+
+private:
+    bool active;
+};
+#else
+// markers with an explicit end() are objects, not macros; they compile to nothing as well
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char*) {}
+    void end() {}
+};
+
+class GpuProfileScope
+{
+public:
+    explicit GpuProfileScope(const char*) {}
+    void end() {}
+};
+#endif
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+
+#ifndef PROFILER_DISABLED
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILE_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#endif
+
+#endif
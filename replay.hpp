@@ -0,0 +1,224 @@
+#ifndef REPLAY_H
+#define REPLAY_H
+
+#include <GLFW/glfw3.h>
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+// Input record/replay for repeatable runs.
+//
+// File: "RCRP" | u32 version | frames...
+//   frame: f32 deltaTime | u16 event count | events...
+//   event: u8 type | f32 time since frame start | key: i16 key, u8 action, u8 mods  /  mouse: f32 x, f32 y
+//
+// Events of frame i are the ones GLFW delivered in the poll at the end of frame i, so replaying
+// dispatches them at the same point and feeds the recorded deltaTime to the simulation.
+
+enum InputEventType : uint8_t { INPUT_KEY = 0, INPUT_MOUSE = 1 };
+
+struct InputEvent {
+    uint8_t type;
+    float time;
+    int16_t key;
+    uint8_t action;
+    uint8_t mods;
+    float x, y;
+};
+
+struct ReplayFrame {
+    float deltaTime;
+    uint32_t firstEvent;
+    uint16_t eventCount;
+};
+
+static const uint32_t replayFileVersion = 1;
+
+class InputRecorder
+{
+public:
+    bool open(const std::string& path)
+    {
+        file.open(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open()) {
+            std::cout << "ERROR::REPLAY:: can't write " << path << std::endl;
+            return false;
+        }
+        file.write("RCRP", 4);
+        file.write((const char*)&replayFileVersion, sizeof(replayFileVersion));
+        events.reserve(64);
+        return true;
+    }
+
+    bool active() const { return file.is_open(); }
+
+    void beginFrame(double time, float deltaTime)
+    {
+        frameStart = time;
+        frameDelta = deltaTime;
+    }
+
+    void key(int key, int action, int mods)
+    {
+        InputEvent e = {};
+        e.type = INPUT_KEY;
+        e.time = (float)(glfwGetTime() - frameStart);
+        e.key = (int16_t)key;
+        e.action = (uint8_t)action;
+        e.mods = (uint8_t)mods;
+        events.push_back(e);
+    }
+
+    void mouse(double x, double y)
+    {
+        InputEvent e = {};
+        e.type = INPUT_MOUSE;
+        e.time = (float)(glfwGetTime() - frameStart);
+        e.x = (float)x;
+        e.y = (float)y;
+        events.push_back(e);
+    }
+
+    // writes this frame's deltaTime and the events collected since beginFrame
+    void endFrame()
+    {
+        uint16_t count = (uint16_t)events.size();
+        write(frameDelta);
+        write(count);
+        for (unsigned int i = 0; i < count; i++) {
+            const InputEvent& e = events[i];
+            write(e.type);
+            write(e.time);
+            if (e.type == INPUT_KEY) {
+                write(e.key);
+                write(e.action);
+                write(e.mods);
+            }
+            else {
+                write(e.x);
+                write(e.y);
+            }
+        }
+        events.clear();
+        frames++;
+    }
+
+    void close()
+    {
+        if (!file.is_open()) return;
+        file.close();
+        std::cout << "Recorded " << frames << " frames of input\n";
+    }
+
+private:
+    std::ofstream file;
+    std::vector<InputEvent> events;
+    double frameStart = 0.0;
+    float frameDelta = 0.0f;
+    unsigned int frames = 0;
+
+    template <typename T>
+    void write(const T& value)
+    {
+        file.write((const char*)&value, sizeof(T));
+    }
+};
+
+class InputReplay
+{
+public:
+    bool fast = false;      // ignore recorded timing, run frames back to back
+
+    // reads the whole file up front so replaying doesn't touch the disk
+    bool open(const std::string& path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        if (!file.is_open()) {
+            std::cout << "ERROR::REPLAY:: can't read " << path << std::endl;
+            return false;
+        }
+        std::vector<char> data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+        uint32_t version = 0;
+        if (data.size() < 8 || memcmp(data.data(), "RCRP", 4) != 0) {
+            std::cout << "ERROR::REPLAY:: " << path << " is not a replay file" << std::endl;
+            return false;
+        }
+        memcpy(&version, data.data() + 4, sizeof(version));
+        if (version != replayFileVersion) {
+            std::cout << "ERROR::REPLAY:: unsupported version " << version << std::endl;
+            return false;
+        }
+
+        size_t pos = 8;
+        while (pos < data.size()) {
+            ReplayFrame frame;
+            if (!read(data, pos, frame.deltaTime) || !read(data, pos, frame.eventCount)) break;
+            frame.firstEvent = (uint32_t)events.size();
+
+            bool ok = true;
+            for (unsigned int i = 0; i < frame.eventCount && ok; i++) {
+                InputEvent e = {};
+                ok = read(data, pos, e.type) && read(data, pos, e.time);
+                if (ok && e.type == INPUT_KEY)
+                    ok = read(data, pos, e.key) && read(data, pos, e.action) && read(data, pos, e.mods);
+                else if (ok)
+                    ok = read(data, pos, e.x) && read(data, pos, e.y);
+                if (ok) events.push_back(e);
+            }
+            if (!ok) {
+                std::cout << "WARNING::REPLAY:: file ends in the middle of a frame, dropping it" << std::endl;
+                events.resize(frame.firstEvent);
+                break;
+            }
+            frames.push_back(frame);
+        }
+
+        std::cout << "Replaying " << frames.size() << " frames, " << events.size() << " events from " << path << "\n";
+        loaded = true;
+        return true;
+    }
+
+    bool active() const { return loaded && current < frames.size(); }
+    bool finished() const { return loaded && current >= frames.size(); }
+    unsigned int frameIndex() const { return current; }
+    unsigned int frameCount() const { return (unsigned int)frames.size(); }
+
+    float deltaTime() const { return frames[current].deltaTime; }
+
+    // feeds the current frame's events to the normal callbacks and moves to the next frame
+    void dispatch(GLFWwindow* window, GLFWkeyfun keyCallback, GLFWcursorposfun mouseCallback)
+    {
+        const ReplayFrame& frame = frames[current];
+        for (unsigned int i = 0; i < frame.eventCount; i++) {
+            const InputEvent& e = events[frame.firstEvent + i];
+            if (e.type == INPUT_KEY)
+                keyCallback(window, e.key, 0, e.action, e.mods);
+            else
+                mouseCallback(window, e.x, e.y);
+        }
+        current++;
+    }
+
+private:
+    std::vector<ReplayFrame> frames;
+    std::vector<InputEvent> events;
+    unsigned int current = 0;
+    bool loaded = false;
+
+    template <typename T>
+    static bool read(const std::vector<char>& data, size_t& pos, T& value)
+    {
+        if (pos + sizeof(T) > data.size()) return false;
+        memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return true;
+    }
+};
+
+#endif
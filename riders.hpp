@@ -0,0 +1,174 @@
+#ifndef RIDERS_H
+#define RIDERS_H
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Riders of one train, structure of arrays indexed by seat.
+//
+// Active, belted and sick are bitsets (64 seats per word), so "all belted?", "all gone?" and "anyone sick?"
+// are a few mask operations instead of a scan over every seat. The seats that are taken are also kept as a
+// compact index list, rebuilt only when someone boards or leaves, which the draw and update loops walk
+// instead of testing every seat.
+class RiderSeats
+{
+public:
+    // per seat, valid only where the seat is active
+    std::vector<glm::vec3> seatOffset;  // in the car's seat frame
+    std::vector<int> model;             // index into passengerModels
+
+    explicit RiderSeats(unsigned int seatCount = 0) { resize(seatCount); }
+
+    // drops every rider
+    void resize(unsigned int seatCount)
+    {
+        seatTotal = seatCount;
+        unsigned int words = (seatCount + 63) / 64;
+        seatOffset.assign(seatCount, glm::vec3(0.0f));
+        model.assign(seatCount, 0);
+        activeBits.assign(words, 0);
+        beltedBits.assign(words, 0);
+        sickBits.assign(words, 0);
+        activeList.clear();
+        activeList.reserve(seatCount);
+    }
+
+    unsigned int seats() const { return seatTotal; }
+
+    // lowest free seat, seats() if the train is full
+    unsigned int freeSeat() const
+    {
+        for (size_t w = 0; w < activeBits.size(); w++) {
+            uint64_t free = ~activeBits[w];
+            if (free) {
+                unsigned int seat = (unsigned int)(w * 64 + lowestBit(free));
+                return seat < seatTotal ? seat : seatTotal;
+            }
+        }
+        return seatTotal;
+    }
+
+    void board(unsigned int seat, int riderModel, const glm::vec3& offset)
+    {
+        seatOffset[seat] = offset;
+        model[seat] = riderModel;
+        set(activeBits, seat, true);
+        set(beltedBits, seat, false);
+        set(sickBits, seat, false);
+        rebuildActiveList();
+    }
+
+    void leave(unsigned int seat)
+    {
+        set(activeBits, seat, false);
+        set(beltedBits, seat, false);
+        set(sickBits, seat, false);
+        rebuildActiveList();
+    }
+
+    void buckle(unsigned int seat) { set(beltedBits, seat, true); }
+    void makeSick(unsigned int seat) { set(sickBits, seat, true); }
+
+    void unbuckleAll()
+    {
+        for (uint64_t& word : beltedBits) word = 0;
+    }
+
+    void clear()
+    {
+        for (size_t w = 0; w < activeBits.size(); w++)
+            activeBits[w] = beltedBits[w] = sickBits[w] = 0;
+        activeList.clear();
+    }
+
+    bool isActive(unsigned int seat) const { return seat < seatTotal && get(activeBits, seat); }
+    bool isBelted(unsigned int seat) const { return seat < seatTotal && get(beltedBits, seat); }
+    bool isSick(unsigned int seat) const { return seat < seatTotal && get(sickBits, seat); }
+
+    unsigned int activeCount() const { return (unsigned int)activeList.size(); }
+    bool allGone() const { return activeList.empty(); }
+
+    // every rider has the belt on (true for an empty train)
+    bool allBelted() const
+    {
+        for (size_t w = 0; w < activeBits.size(); w++)
+            if (activeBits[w] & ~beltedBits[w]) return false;
+        return true;
+    }
+
+    unsigned int sickCount() const
+    {
+        unsigned int count = 0;
+        for (size_t w = 0; w < sickBits.size(); w++)
+            count += popcount(sickBits[w] & activeBits[w]);
+        return count;
+    }
+
+    // taken seats in ascending order
+    const std::vector<unsigned int>& active() const { return activeList; }
+
+private:
+    unsigned int seatTotal = 0;
+    std::vector<uint64_t> activeBits, beltedBits, sickBits;
+    std::vector<unsigned int> activeList;
+
+    static void set(std::vector<uint64_t>& bits, unsigned int seat, bool on)
+    {
+        uint64_t mask = uint64_t(1) << (seat & 63);
+        if (on) bits[seat >> 6] |= mask;
+        else bits[seat >> 6] &= ~mask;
+    }
+
+    static bool get(const std::vector<uint64_t>& bits, unsigned int seat)
+    {
+        return (bits[seat >> 6] >> (seat & 63)) & 1;
+    }
+
+    void rebuildActiveList()
+    {
+        activeList.clear();
+        for (size_t w = 0; w < activeBits.size(); w++) {
+            uint64_t word = activeBits[w];
+            while (word) {
+                activeList.push_back((unsigned int)(w * 64 + lowestBit(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    static unsigned int popcount(uint64_t x)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        return (unsigned int)__popcnt64(x);
+#elif defined(_MSC_VER)
+        return __popcnt((unsigned int)x) + __popcnt((unsigned int)(x >> 32));
+#else
+        return (unsigned int)__builtin_popcountll(x);
+#endif
+    }
+
+    // index of the lowest set bit, x != 0
+    static unsigned int lowestBit(uint64_t x)
+    {
+#if defined(_MSC_VER) && defined(_M_X64)
+        unsigned long index;
+        _BitScanForward64(&index, x);
+        return (unsigned int)index;
+#elif defined(_MSC_VER)
+        unsigned long index;
+        if (_BitScanForward(&index, (unsigned long)x)) return (unsigned int)index;
+        _BitScanForward(&index, (unsigned long)(x >> 32));
+        return (unsigned int)index + 32;
+#else
+        return (unsigned int)__builtin_ctzll(x);
+#endif
+    }
+};
+
+#endif
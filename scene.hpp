@@ -0,0 +1,262 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "model.hpp"
+#include "frustum.hpp"
+#include "octree.hpp"
+#include "track.hpp"
+#include "trackgen.hpp"
+#include "memstats.hpp"
+#include "trains.hpp"
+#include "profiler.hpp"
+
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Park layout: several coaster tracks, each with its own transform and trains, plus static props.
+//
+// Scene file, one entry per line, '#' starts a comment. Angles are degrees around +Y.
+//   track   <obj|.track> <x> <y> <z> <yaw> <scale> [trains]       .track = control points (trackgen.hpp)
+//   prop    <obj> <x> <y> <z> <yaw> <scale>
+//   scatter <obj> <count> <x> <z> <radius> <scale>      props at random spots in a circle (fixed seed)
+//
+// Track rails and props are static and live in a loose octree, so culling and proximity queries only
+// touch the nodes around the camera / query point. Trains move and are drawn per track.
+
+struct SceneTrack {
+    unsigned int model;         // index into Scene::models
+    glm::mat4 transform;
+    unsigned int trainCount;
+    std::vector<glm::vec3> path;    // world space key points the trains follow
+    TrainManager trains;
+};
+
+struct SceneObject {
+    unsigned int model;
+    glm::mat4 transform;
+};
+
+class Scene
+{
+public:
+    std::vector<Model> models;
+    std::vector<SceneTrack> tracks;     // tracks[0] carries the rider train
+    std::vector<SceneObject> objects;   // static: every track's rails and all props
+    LooseOctree octree;
+
+    // ties and supports of the procedural (.track) tracks, drawn instanced
+    TrackShape trackShape;
+    TrackInstances trackParts;
+
+    bool load(const std::string& path, unsigned int defaultTrains)
+    {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cout << "ERROR::SCENE:: can't read " << path << std::endl;
+            return false;
+        }
+
+        std::mt19937 rng(7u);
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::stringstream ss(line);
+            std::string type, obj;
+            if (!(ss >> type)) continue;
+
+            if (type == "track" || type == "prop") {
+                glm::vec3 position;
+                float yaw = 0.0f, scale = 1.0f;
+                unsigned int trains = defaultTrains;
+                if (!(ss >> obj >> position.x >> position.y >> position.z >> yaw >> scale)) {
+                    std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " expected '" << type << " <obj> x y z yaw scale'" << std::endl;
+                    continue;
+                }
+                if (type == "track") {
+                    ss >> trains;
+                    addTrack(obj, placement(position, yaw, scale), trains);
+                }
+                else {
+                    addProp(obj, placement(position, yaw, scale));
+                }
+            }
+            else if (type == "scatter") {
+                unsigned int count = 0;
+                float x, z, radius, scale;
+                if (!(ss >> obj >> count >> x >> z >> radius >> scale)) {
+                    std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " expected 'scatter <obj> count x z radius scale'" << std::endl;
+                    continue;
+                }
+                std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+                for (unsigned int i = 0; i < count; i++) {
+                    float a = unit(rng) * glm::two_pi<float>();
+                    float r = radius * std::sqrt(unit(rng));
+                    addProp(obj, placement(glm::vec3(x + r * cos(a), 0.0f, z + r * sin(a)), unit(rng) * 360.0f, scale));
+                }
+            }
+            else {
+                std::cout << "ERROR::SCENE:: " << path << ":" << lineNumber << " unknown entry '" << type << "'" << std::endl;
+            }
+        }
+
+        if (tracks.empty()) {
+            std::cout << "ERROR::SCENE:: " << path << " has no track" << std::endl;
+            return false;
+        }
+        return true;
+    }
+
+    void addTrack(const std::string& obj, const glm::mat4& transform, unsigned int trainCount)
+    {
+        SceneTrack track;
+        track.model = modelIndex(obj);
+        track.transform = transform;
+        track.trainCount = trainCount;
+        tracks.push_back(track);
+        objects.push_back({ track.model, transform });
+    }
+
+    void addProp(const std::string& obj, const glm::mat4& transform)
+    {
+        objects.push_back({ modelIndex(obj), transform });
+    }
+
+    // loads every model once, builds the track paths, starts the trains and builds the octree.
+    // Needs a current context. 'blockCount' 0 picks three blocks per train. False if a procedural track has
+    // no usable control points.
+    bool finish(unsigned int blockCount)
+    {
+        PROFILE_SCOPE("Scene::finish");
+        models.reserve(modelPaths.size());
+        // key points depend only on the obj, share them between instances of the same track
+        std::map<unsigned int, std::vector<glm::vec3>> localPaths;
+        std::vector<Texture> generatedTextures;
+        for (unsigned int i = 0; i < modelPaths.size(); i++) {
+            if (!isProceduralTrack(modelPaths[i])) {
+                models.push_back(Model(modelPaths[i]));
+                continue;
+            }
+            // centreline from the control points, rails swept along it, no obj to import or parse
+            if (generatedTextures.empty())
+                generatedTextures.push_back({ TextureFromFile("plastic.jpg", "res"), "uDiffMap", "plastic.jpg" });
+            std::vector<glm::vec3> control;
+            std::vector<Mesh> meshes;
+            if (loadControlPoints(modelPaths[i], control)) {
+                sampleCentreline(control, trackShape.samplesPerSegment, localPaths[i]);
+                meshes.push_back(buildTrackMesh(localPaths[i], trackShape, generatedTextures));
+                std::cout << "Generated " << localPaths[i].size() << " points, " << meshes[0].vertices.size() << " vertices from "
+                          << control.size() << " control points (" << modelPaths[i] << ").\n";
+            }
+            else {
+                std::cout << "ERROR::SCENE:: track " << modelPaths[i] << " has no usable centreline" << std::endl;
+                return false;
+            }
+            models.push_back(Model(meshes));
+        }
+
+        for (SceneTrack& track : tracks) {
+            if (!localPaths.count(track.model)) {
+                std::vector<glm::vec3> raw, keyPoints, sorted;
+                loadTrackVertices(modelPaths[track.model], raw);
+                generateKeyPoints(raw, keyPoints, sorted);
+                std::cout << "Sorted " << sorted.size() << " points for a continuous loop (" << modelPaths[track.model] << ").\n";
+                localPaths[track.model].swap(sorted);
+            }
+            const std::vector<glm::vec3>& local = localPaths[track.model];
+            track.path.resize(local.size());
+            for (size_t i = 0; i < local.size(); i++)
+                track.path[i] = glm::vec3(track.transform * glm::vec4(local[i], 1.0f));
+            if (isProceduralTrack(modelPaths[track.model]))
+                trackInstances(track.path, maxAxisScale(track.transform), trackShape, trackParts.ties, trackParts.supports);
+        }
+        trackParts.create(trackShape, generatedTextures);
+
+        // tracks no longer change, the managers can keep pointers to the paths
+        for (size_t k = 0; k < tracks.size(); k++) {
+            SceneTrack& track = tracks[k];
+            track.trains.init(track.path, track.trainCount, blockCount ? blockCount : std::max(16u, track.trainCount * 3));
+            // only the first track has riders, train 0 elsewhere loops like the rest
+            if (k > 0) track.trains.state[0] = MOVING;
+        }
+
+        std::vector<glm::vec3> boxMin(objects.size()), boxMax(objects.size());
+        for (size_t i = 0; i < objects.size(); i++) {
+            const Bounds& b = models[objects[i].model].bounds;
+            glm::vec3 center, extents;
+            transformBox(objects[i].transform, b.min, b.max, center, extents);
+            boxMin[i] = center - extents;
+            boxMax[i] = center + extents;
+        }
+        octree.build(boxMin, boxMax);
+
+        std::cout << "Scene: " << tracks.size() << " tracks, " << objects.size() << " objects, " << models.size() << " models, "
+                  << octree.nodeCount() << " octree nodes";
+        if (trackParts.ready()) std::cout << ", " << trackParts.ties.size() << " ties and " << trackParts.supports.size() << " supports instanced";
+        std::cout << "\n";
+        return true;
+    }
+
+    // static objects touching the frustum
+    void visible(const Frustum& frustum, std::vector<unsigned int>& out) const
+    {
+        PROFILE_SCOPE("Scene::visible");
+        octree.queryFrustum(frustum, out);
+    }
+
+    // static objects within 'radius' of 'point'
+    void nearby(const glm::vec3& point, float radius, std::vector<unsigned int>& out) const
+    {
+        octree.querySphere(point, radius, out);
+    }
+
+    // every model under its path, plus the instanced track parts
+    void report(MemoryReport& memory) const
+    {
+        for (size_t i = 0; i < models.size(); i++)
+            memory.add(modelPaths[i], models[i]);
+        if (trackParts.ready()) memory.addGpu("track ties and supports", trackParts.bufferBytes(), 0);
+    }
+
+    // world space bounding sphere of a track's rails
+    void trackSphere(unsigned int k, glm::vec3& center, float& radius) const
+    {
+        const SceneTrack& track = tracks[k];
+        const Bounds& b = models[track.model].bounds;
+        center = glm::vec3(track.transform * glm::vec4(b.center, 1.0f));
+        radius = b.radius * maxAxisScale(track.transform);
+    }
+
+private:
+    std::vector<std::string> modelPaths;
+    std::map<std::string, unsigned int> modelIndices;
+
+    unsigned int modelIndex(const std::string& path)
+    {
+        std::map<std::string, unsigned int>::iterator it = modelIndices.find(path);
+        if (it != modelIndices.end()) return it->second;
+        unsigned int index = (unsigned int)modelPaths.size();
+        modelPaths.push_back(path);
+        modelIndices[path] = index;
+        return index;
+    }
+
+    static glm::mat4 placement(const glm::vec3& position, float yaw, float scale)
+    {
+        glm::mat4 m = glm::translate(glm::mat4(1.0f), position);
+        m = glm::rotate(m, glm::radians(yaw), glm::vec3(0.0f, 1.0f, 0.0f));
+        return glm::scale(m, glm::vec3(scale));
+    }
+};
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef SEATING_H
+#define SEATING_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Seat layouts per car type and rider model fits, loaded from a small table (res/seating.table) instead of
+// being computed in code.
+//
+// Table, one entry per line, '#' starts a comment:
+//   car   <name> <car obj> <seats obj>          starts a car type
+//   seat  <x> <y> <z>                           one seat in the car's seat frame, in boarding order
+//   grid  <nx> <nz> <x0> <y> <z0> <dx> <dz>     nx * nz seats, x major (same order as single seats)
+//   rider <obj> <scale> <x> <y> <z>             a rider model, its scale and offset in a seat
+//
+// At load every layout is baked into one contiguous array of seat matrices and every rider into its fit
+// matrix, so boarding and drawing are lookups.
+
+struct RiderFit {
+    std::string path;
+    float scale;
+    glm::vec3 offset;
+    glm::mat4 fit;              // translate(offset) * scale, applied after the car rotation
+};
+
+struct CarLayout {
+    std::string name;
+    std::string carModel, seatsModel;
+    std::vector<glm::vec3> seatOffsets;
+    std::vector<glm::mat4> seatTransforms;     // baked, index = seat
+
+    unsigned int seats() const { return (unsigned int)seatTransforms.size(); }
+};
+
+class SeatingTable
+{
+public:
+    std::vector<CarLayout> layouts;
+    std::vector<RiderFit> riders;
+
+    bool load(const std::string& path)
+    {
+        std::ifstream file(path);
+        if (!file.is_open()) {
+            std::cout << "ERROR::SEATING:: can't read " << path << std::endl;
+            return false;
+        }
+
+        std::string line;
+        int lineNumber = 0;
+        while (std::getline(file, line)) {
+            lineNumber++;
+            line = line.substr(0, line.find('#'));
+            std::stringstream ss(line);
+            std::string type;
+            if (!(ss >> type)) continue;
+
+            if (type == "car") {
+                CarLayout layout;
+                if (!(ss >> layout.name >> layout.carModel >> layout.seatsModel)) {
+                    error(path, lineNumber, "expected 'car <name> <car obj> <seats obj>'");
+                    continue;
+                }
+                layouts.push_back(layout);
+            }
+            else if (type == "seat" || type == "grid") {
+                if (layouts.empty()) {
+                    error(path, lineNumber, "seat before the first car");
+                    continue;
+                }
+                std::vector<glm::vec3>& seats = layouts.back().seatOffsets;
+                if (type == "seat") {
+                    glm::vec3 p;
+                    if (ss >> p.x >> p.y >> p.z) seats.push_back(p);
+                    else error(path, lineNumber, "expected 'seat x y z'");
+                }
+                else {
+                    int nx, nz;
+                    float x0, y, z0, dx, dz;
+                    if (!(ss >> nx >> nz >> x0 >> y >> z0 >> dx >> dz)) {
+                        error(path, lineNumber, "expected 'grid nx nz x0 y z0 dx dz'");
+                        continue;
+                    }
+                    for (int a = 0; a < nx; a++)
+                        for (int b = 0; b < nz; b++)
+                            seats.push_back(glm::vec3(x0 + a * dx, y, z0 + b * dz));
+                }
+            }
+            else if (type == "rider") {
+                RiderFit rider;
+                if (!(ss >> rider.path >> rider.scale >> rider.offset.x >> rider.offset.y >> rider.offset.z)) {
+                    error(path, lineNumber, "expected 'rider <obj> scale x y z'");
+                    continue;
+                }
+                riders.push_back(rider);
+            }
+            else {
+                error(path, lineNumber, "unknown entry '" + type + "'");
+            }
+        }
+
+        if (layouts.empty() || riders.empty()) {
+            std::cout << "ERROR::SEATING:: " << path << " needs at least one car and one rider" << std::endl;
+            return false;
+        }
+        for (const CarLayout& layout : layouts) {
+            if (layout.seatOffsets.empty()) {
+                std::cout << "ERROR::SEATING:: car type '" << layout.name << "' has no seats" << std::endl;
+                return false;
+            }
+        }
+        bake();
+        return true;
+    }
+
+    // layout by name, the first one for an empty name, nullptr if there is none
+    const CarLayout* find(const std::string& name) const
+    {
+        if (name.empty()) return layouts.empty() ? nullptr : &layouts[0];
+        for (const CarLayout& layout : layouts)
+            if (layout.name == name) return &layout;
+        std::cout << "ERROR::SEATING:: no car type '" << name << "'" << std::endl;
+        return nullptr;
+    }
+
+    // rider model sitting in a seat, models repeat on trains with more seats than models
+    unsigned int riderFor(unsigned int seat) const { return seat % (unsigned int)riders.size(); }
+
+private:
+    void bake()
+    {
+        for (CarLayout& layout : layouts) {
+            layout.seatTransforms.resize(layout.seatOffsets.size());
+            for (size_t i = 0; i < layout.seatOffsets.size(); i++)
+                layout.seatTransforms[i] = glm::translate(glm::mat4(1.0f), layout.seatOffsets[i]);
+        }
+        for (RiderFit& rider : riders)
+            rider.fit = glm::scale(glm::translate(glm::mat4(1.0f), rider.offset), glm::vec3(rider.scale));
+    }
+
+    static void error(const std::string& path, int lineNumber, const std::string& message)
+    {
+        std::cout << "ERROR::SEATING:: " << path << ":" << lineNumber << " " << message << std::endl;
+    }
+};
+
+#endif
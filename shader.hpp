@@ -8,14 +8,32 @@
 #include <fstream>
 #include <sstream>
 #include <iostream>
+#include <vector>
+#include <cstdint>
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
 
 class Shader
 {
 public:
     unsigned int ID;
+    bool loadedFromCache = false;
+
+    // linked programs are cached here with glGetProgramBinary, keyed by source + driver + binary format.
+    // An empty string turns the cache off.
+    static std::string& cacheDirectory()
+    {
+        static std::string directory = "shadercache";
+        return directory;
+    }
     // constructor generates the shader on the fly
+    // 'defines' (e.g. "#define INDIRECT\n") is inserted right after the #version line of both stages
     // ------------------------------------------------------------------------
-    Shader(const char* vertexPath, const char* fragmentPath)
+    Shader(const char* vertexPath, const char* fragmentPath, const std::string& defines = "")
     {
         // 1. retrieve the vertex/fragment source code from filePath
         std::string vertexCode;
@@ -45,9 +63,26 @@ public:
         {
             std::cout << "ERROR::SHADER::FILE_NOT_SUCCESSFULLY_READ: " << e.what() << std::endl;
         }
+        if (!defines.empty())
+        {
+            vertexCode = injectDefines(vertexCode, defines);
+            fragmentCode = injectDefines(fragmentCode, defines);
+        }
+        // 2. a binary from an earlier run with the same sources and driver skips compiling and linking
+        std::string cacheKey, cachePath;
+        if (binaryCacheSupported())
+        {
+            cacheKey = programCacheKey(vertexCode, fragmentCode);
+            cachePath = cacheDirectory() + "/" + toHex(fnv1a(cacheKey)) + ".bin";
+            if (loadProgramBinary(cachePath, cacheKey))
+            {
+                loadedFromCache = true;
+                return;
+            }
+        }
         const char* vShaderCode = vertexCode.c_str();
         const char* fShaderCode = fragmentCode.c_str();
-        // 2. compile shaders
+        // 3. compile shaders
         unsigned int vertex, fragment;
         // vertex shader
         vertex = glCreateShader(GL_VERTEX_SHADER);
@@ -61,6 +96,8 @@ public:
         checkCompileErrors(fragment, "FRAGMENT");
         // shader Program
         ID = glCreateProgram();
+        if (!cacheKey.empty())
+            glProgramParameteri(ID, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
         glAttachShader(ID, vertex);
         glAttachShader(ID, fragment);
         glLinkProgram(ID);
@@ -68,7 +105,9 @@ public:
         // delete the shaders as they're linked into our program now and no longer necessary
         glDeleteShader(vertex);
         glDeleteShader(fragment);
-
+        // 4. store the linked binary for the next start
+        if (!cacheKey.empty())
+            saveProgramBinary(cachePath, cacheKey);
     }
     // activate the shader
     // ------------------------------------------------------------------------
@@ -76,66 +115,203 @@ public:
     {
         glUseProgram(ID);
     }
-    // utility uniform functions
+    // utility uniform functions, names are plain C strings so a call never builds a std::string
     // ------------------------------------------------------------------------
-    void setBool(const std::string& name, bool value) const
+    void setBool(const char* name, bool value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), (int)value);
+        glUniform1i(glGetUniformLocation(ID, name), (int)value);
     }
     // ------------------------------------------------------------------------
-    void setInt(const std::string& name, int value) const
+    void setInt(const char* name, int value) const
     {
-        glUniform1i(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1i(glGetUniformLocation(ID, name), value);
     }
     // ------------------------------------------------------------------------
-    void setFloat(const std::string& name, float value) const
+    void setFloat(const char* name, float value) const
     {
-        glUniform1f(glGetUniformLocation(ID, name.c_str()), value);
+        glUniform1f(glGetUniformLocation(ID, name), value);
     }
     // ------------------------------------------------------------------------
-    void setVec2(const std::string& name, const glm::vec2& value) const
+    void setVec2(const char* name, const glm::vec2& value) const
     {
-        glUniform2fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform2fv(glGetUniformLocation(ID, name), 1, &value[0]);
     }
-    void setVec2(const std::string& name, float x, float y) const
+    void setVec2(const char* name, float x, float y) const
     {
-        glUniform2f(glGetUniformLocation(ID, name.c_str()), x, y);
+        glUniform2f(glGetUniformLocation(ID, name), x, y);
     }
     // ------------------------------------------------------------------------
-    void setVec3(const std::string& name, const glm::vec3& value) const
+    void setVec3(const char* name, const glm::vec3& value) const
     {
-        glUniform3fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform3fv(glGetUniformLocation(ID, name), 1, &value[0]);
     }
-    void setVec3(const std::string& name, float x, float y, float z) const
+    void setVec3(const char* name, float x, float y, float z) const
     {
-        glUniform3f(glGetUniformLocation(ID, name.c_str()), x, y, z);
+        glUniform3f(glGetUniformLocation(ID, name), x, y, z);
     }
     // ------------------------------------------------------------------------
-    void setVec4(const std::string& name, const glm::vec4& value) const
+    void setVec4(const char* name, const glm::vec4& value) const
     {
-        glUniform4fv(glGetUniformLocation(ID, name.c_str()), 1, &value[0]);
+        glUniform4fv(glGetUniformLocation(ID, name), 1, &value[0]);
     }
-    void setVec4(const std::string& name, float x, float y, float z, float w) const
+    void setVec4(const char* name, float x, float y, float z, float w) const
     {
-        glUniform4f(glGetUniformLocation(ID, name.c_str()), x, y, z, w);
+        glUniform4f(glGetUniformLocation(ID, name), x, y, z, w);
     }
     // ------------------------------------------------------------------------
-    void setMat2(const std::string& name, const glm::mat2& mat) const
+    void setMat2(const char* name, const glm::mat2& mat) const
     {
-        glUniformMatrix2fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix2fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat3(const std::string& name, const glm::mat3& mat) const
+    void setMat3(const char* name, const glm::mat3& mat) const
     {
-        glUniformMatrix3fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix3fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
     // ------------------------------------------------------------------------
-    void setMat4(const std::string& name, const glm::mat4& mat) const
+    void setMat4(const char* name, const glm::mat4& mat) const
     {
-        glUniformMatrix4fv(glGetUniformLocation(ID, name.c_str()), 1, GL_FALSE, &mat[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(ID, name), 1, GL_FALSE, &mat[0][0]);
     }
 
 private:
+    // ------------------------------------------------------------------------
+    static bool binaryCacheSupported()
+    {
+        if (cacheDirectory().empty() || !(GLEW_VERSION_4_1 || GLEW_ARB_get_program_binary))
+            return false;
+        // some drivers expose the API but no formats
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        return formats > 0;
+    }
+    // ------------------------------------------------------------------------
+    static uint64_t fnv1a(const std::string& data)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (unsigned char c : data)
+        {
+            hash ^= c;
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+    static std::string toHex(uint64_t value)
+    {
+        static const char digits[] = "0123456789abcdef";
+        std::string out(16, '0');
+        for (int i = 15; i >= 0; i--, value >>= 4)
+            out[i] = digits[value & 0xF];
+        return out;
+    }
+    // the binary is only valid for the exact sources on the exact driver build
+    // ------------------------------------------------------------------------
+    static std::string programCacheKey(const std::string& vertexCode, const std::string& fragmentCode)
+    {
+        const char* vendor = (const char*)glGetString(GL_VENDOR);
+        const char* renderer = (const char*)glGetString(GL_RENDERER);
+        const char* version = (const char*)glGetString(GL_VERSION);
+        return "src:" + toHex(fnv1a(vertexCode + '\0' + fragmentCode))
+            + "|vendor:" + (vendor ? vendor : "")
+            + "|renderer:" + (renderer ? renderer : "")
+            + "|version:" + (version ? version : "");
+    }
+    // file: "SPBC" | key length | key | binary format | binary length | binary
+    // ------------------------------------------------------------------------
+    bool loadProgramBinary(const std::string& path, const std::string& key)
+    {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+        // lengths in the header are only trusted if they add up to the file, a truncated or corrupted cache
+        // must not turn into a huge allocation
+        const uint64_t fileSize = (uint64_t)file.tellg();
+        file.seekg(0);
+
+        char magic[4];
+        uint32_t keyLength = 0, format = 0, length = 0;
+        file.read(magic, 4);
+        file.read((char*)&keyLength, sizeof(keyLength));
+        if (!file || std::string(magic, 4) != "SPBC" || keyLength != key.size() || 16ull + keyLength > fileSize)
+            return false;
+        std::string storedKey(keyLength, '\0');
+        file.read(&storedKey[0], keyLength);
+        file.read((char*)&format, sizeof(format));
+        file.read((char*)&length, sizeof(length));
+        if (!file || storedKey != key || !formatSupported(format) || length == 0 || 16ull + keyLength + length != fileSize)
+            return false;
+        std::vector<char> binary(length);
+        file.read(binary.data(), length);
+        if (!file)
+            return false;
+
+        ID = glCreateProgram();
+        glProgramBinary(ID, format, binary.data(), (GLsizei)length);
+        GLint success = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        if (!success)
+        {
+            // driver rejected it anyway (e.g. updated in place), compile from source instead
+            glDeleteProgram(ID);
+            ID = 0;
+            return false;
+        }
+        return true;
+    }
+    // ------------------------------------------------------------------------
+    void saveProgramBinary(const std::string& path, const std::string& key) const
+    {
+        GLint success = 0, length = 0;
+        glGetProgramiv(ID, GL_LINK_STATUS, &success);
+        glGetProgramiv(ID, GL_PROGRAM_BINARY_LENGTH, &length);
+        if (!success || length <= 0)
+            return;
+
+        std::vector<char> binary(length);
+        GLenum format = 0;
+        glGetProgramBinary(ID, length, NULL, &format, binary.data());
+
+#ifdef _WIN32
+        _mkdir(cacheDirectory().c_str());
+#else
+        mkdir(cacheDirectory().c_str(), 0755);
+#endif
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+        {
+            std::cout << "WARNING::SHADER::CACHE:: can't write " << path << std::endl;
+            return;
+        }
+        uint32_t keyLength = (uint32_t)key.size(), storedFormat = format, storedLength = (uint32_t)length;
+        file.write("SPBC", 4);
+        file.write((const char*)&keyLength, sizeof(keyLength));
+        file.write(key.data(), keyLength);
+        file.write((const char*)&storedFormat, sizeof(storedFormat));
+        file.write((const char*)&storedLength, sizeof(storedLength));
+        file.write(binary.data(), length);
+    }
+    // ------------------------------------------------------------------------
+    static bool formatSupported(GLenum format)
+    {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &count);
+        std::vector<GLint> formats(count);
+        if (count > 0)
+            glGetIntegerv(GL_PROGRAM_BINARY_FORMATS, formats.data());
+        for (GLint f : formats)
+            if ((GLenum)f == format)
+                return true;
+        return false;
+    }
+    // puts the defines after the first line, #version has to stay first
+    // ------------------------------------------------------------------------
+    static std::string injectDefines(const std::string& code, const std::string& defines)
+    {
+        size_t lineEnd = code.find('\n');
+        if (code.compare(0, 8, "#version") != 0 || lineEnd == std::string::npos)
+            return defines + code;
+        return code.substr(0, lineEnd + 1) + defines + code.substr(lineEnd + 1);
+    }
     // utility function for checking shader compilation/linking errors.
     // ------------------------------------------------------------------------
     void checkCompileErrors(GLuint shader, std::string type)
@@ -0,0 +1,19 @@
+#version 330 core
+layout (location = 0) in vec3 inPos;
+
+// depth only pass for shadows.hpp
+#ifdef INSTANCED
+layout (location = 3) in mat4 inModel;
+#else
+uniform mat4 uM;
+#endif
+uniform mat4 uLightSpace;
+
+void main()
+{
+#ifdef INSTANCED
+    gl_Position = uLightSpace * inModel * vec4(inPos, 1.0);
+#else
+    gl_Position = uLightSpace * uM * vec4(inPos, 1.0);
+#endif
+}
@@ -0,0 +1,299 @@
+#ifndef SHADOWS_H
+#define SHADOWS_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "shader.hpp"
+#include "profiler.hpp"
+#include "frustum.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+// Sun shadows in two layers.
+//
+// The static layer covers the whole park (rails, props) at high resolution and is only re-rendered when
+// the light or the static scene changes, invalidate() forces it. The dynamic layer is an atlas re-rendered
+// every frame with one square tile per moving caster the caller passes in (a train with its riders),
+// fitted tightly across the light. Along the light every tile spans the whole scene sphere, so a shadow
+// still lands on receivers far below its caster. Casters whose shadow can't reach the view are left out
+// by the caller (reachesView()). Past maxDynamicTiles casters share tiles, which then get coarser.
+// basic.frag (with SHADOWS defined) samples both layers and keeps the darker result.
+//
+// Usage per frame:
+//   if (shadows.beginStatic(shadowShader)) { draw static casters; shadows.end(); }
+//   shadows.beginDynamic(shadowShader, spheres, count);
+//   for each caster i: shadows.dynamicCaster(shadowShader, i); draw it;
+//   shadows.end();
+//   shadows.bind(sceneShader);
+class ShadowMaps
+{
+public:
+    // texture units, above the clustered lighting buffers
+    static const int staticUnit = 11;
+    static const int dynamicUnit = 12;
+    // tiles in the dynamic atlas, the uniform arrays in basic.frag have this size
+    static const unsigned int maxDynamicTiles = 16;
+
+    // how often each layer was rendered, for the report
+    unsigned int staticRenders = 0;
+    unsigned int dynamicRenders = 0;
+
+    bool create(int staticResolution = 4096, int dynamicResolution = 2048)
+    {
+        staticSize = staticResolution;
+        dynamicSize = dynamicResolution;
+        bool complete = createLayer(staticLayer, staticSize) && createLayer(dynamicLayer, dynamicSize);
+        if (!complete) {
+            std::cout << "ERROR::SHADOWS:: framebuffer not complete" << std::endl;
+            release();
+            return false;
+        }
+        created = true;
+        staticValid = false;
+        return true;
+    }
+
+    void release()
+    {
+        releaseLayer(staticLayer);
+        releaseLayer(dynamicLayer);
+        created = false;
+    }
+
+    bool ready() const { return created; }
+
+    // direction the light travels in and a sphere around everything static. Only a change re-renders the
+    // static layer.
+    void setLight(const glm::vec3& direction, const glm::vec3& sceneCenter, float sceneRadius)
+    {
+        glm::vec4 light[2] = { glm::vec4(glm::normalize(direction), 0.0f), glm::vec4(sceneCenter, sceneRadius) };
+        if (staticValid && memcmp(light, lightKey, sizeof(light)) == 0) return;
+        memcpy(lightKey, light, sizeof(light));
+        lightDirection = glm::vec3(light[0]);
+        sceneSphere = light[1];
+        staticSpace = fit(sceneCenter, sceneRadius, staticSize);
+        staticValid = false;
+    }
+
+    // static casters changed (scene reloaded, props moved)
+    void invalidate() { staticValid = false; }
+
+    // binds the static layer if it needs to be rendered, false if the cached one is still good
+    bool beginStatic(Shader& shadowShader)
+    {
+        if (!created || staticValid) return false;
+        begin(staticLayer, staticSize, staticSpace, shadowShader);
+        staticValid = true;
+        staticRenders++;
+        return true;
+    }
+
+    // the shadow of a caster inside this sphere can fall on something the camera sees: the sphere swept along
+    // the light up to the far side of the scene touches the frustum
+    bool reachesView(const Frustum& frustum, const glm::vec3& center, float radius) const
+    {
+        float reach = std::max(0.0f, glm::dot(glm::vec3(sceneSphere) - center, lightDirection) + sceneSphere.w);
+        return frustum.testSweptSphere(center, radius, lightDirection, reach);
+    }
+
+    // binds and clears the dynamic atlas and fits a tile around each caster sphere (xyz center, w radius)
+    void beginDynamic(Shader& shadowShader, const glm::vec4* casters, unsigned int count)
+    {
+        tileCount = std::min(count, maxDynamicTiles);
+        tileGrid = 1;
+        while (tileGrid * tileGrid < tileCount) tileGrid++;
+        tilePixels = dynamicSize / (int)tileGrid;
+
+        glm::mat4 view = lightView();
+        glm::vec3 scene = glm::vec3(view * glm::vec4(glm::vec3(sceneSphere), 1.0f));
+        float nearZ = -scene.z - sceneSphere.w;
+        float farZ = -scene.z + sceneSphere.w;
+
+        glm::vec2 low[maxDynamicTiles], high[maxDynamicTiles];
+        for (unsigned int t = 0; t < tileCount; t++) {
+            low[t] = glm::vec2(INFINITY);
+            high[t] = glm::vec2(-INFINITY);
+        }
+        for (unsigned int i = 0; i < count; i++) {
+            glm::vec3 c = glm::vec3(view * glm::vec4(glm::vec3(casters[i]), 1.0f));
+            float radius = casters[i].w;
+            unsigned int t = i % tileCount;
+            low[t] = glm::min(low[t], glm::vec2(c) - radius);
+            high[t] = glm::max(high[t], glm::vec2(c) + radius);
+            nearZ = std::min(nearZ, -c.z - radius);
+            farZ = std::max(farZ, -c.z + radius);
+        }
+
+        // x/y only, the shader gets light view units and the tile scale/offset separately
+        dynamicSpace = glm::ortho(-1.0f, 1.0f, -1.0f, 1.0f, nearZ, farZ) * view;
+        float tileSize = (float)tilePixels / dynamicSize;
+        float atlasTexel = 1.0f / dynamicSize;
+        for (unsigned int t = 0; t < tileCount; t++) {
+            // a texel of margin on every side keeps the 2x2 PCF taps inside the tile, snapped to whole texels so a
+            // tile doesn't shimmer while its train moves
+            glm::vec2 extents = high[t] - low[t];
+            float side = std::max(extents.x, extents.y);
+            float texel = std::max(side, 0.01f) / (tilePixels - 4);
+            glm::vec2 corner = (low[t] + high[t]) * 0.5f - side * 0.5f;
+            glm::vec2 start = glm::floor(corner / texel) * texel - texel;
+            float span = texel * tilePixels;
+            tileSpace[t] = glm::ortho(start.x, start.x + span, start.y, start.y + span, nearZ, farZ) * view;
+
+            glm::vec2 origin = glm::vec2((float)(t % tileGrid), (float)(t / tileGrid)) * tileSize;
+            float scale = tileSize / span;
+            tileTransform[t] = glm::vec4(origin - start * scale, scale, 0.0f);
+            tileRect[t] = glm::vec4(origin + atlasTexel, origin + tileSize - atlasTexel);
+        }
+
+        begin(dynamicLayer, dynamicSize, dynamicSpace, shadowShader);
+        dynamicRenders++;
+    }
+
+    // viewport and light space of the tile caster 'index' (as passed to beginDynamic) is drawn into
+    void dynamicCaster(Shader& shadowShader, unsigned int index) const
+    {
+        unsigned int t = index % tileCount;
+        glViewport((int)(t % tileGrid) * tilePixels, (int)(t / tileGrid) * tilePixels, tilePixels, tilePixels);
+        shadowShader.setMat4("uLightSpace", tileSpace[t]);
+    }
+
+    unsigned int dynamicTiles() const { return tileCount; }
+
+    // back to the framebuffer and viewport that were bound before begin*()
+    void end()
+    {
+        glDisable(GL_POLYGON_OFFSET_FILL);
+        glBindFramebuffer(GL_FRAMEBUFFER, previousFramebuffer);
+        glViewport(previousViewport[0], previousViewport[1], previousViewport[2], previousViewport[3]);
+    }
+
+    // light space of the static layer, for casters drawn with another shader between beginStatic() and end()
+    const glm::mat4& staticLightSpace() const { return staticSpace; }
+
+    // call with the scene shader in use
+    void bind(Shader& shader) const
+    {
+        glActiveTexture(GL_TEXTURE0 + staticUnit);
+        glBindTexture(GL_TEXTURE_2D, staticLayer.depth);
+        glActiveTexture(GL_TEXTURE0 + dynamicUnit);
+        glBindTexture(GL_TEXTURE_2D, dynamicLayer.depth);
+        glActiveTexture(GL_TEXTURE0);
+
+        shader.setInt("uShadowStatic", staticUnit);
+        shader.setInt("uShadowDynamic", dynamicUnit);
+        shader.setMat4("uShadowStaticSpace", staticSpace);
+        shader.setMat4("uShadowDynamicSpace", dynamicSpace);
+        shader.setInt("uShadowTileCount", (int)tileCount);
+        if (tileCount) {
+            glUniform4fv(glGetUniformLocation(shader.ID, "uShadowTiles"), tileCount, &tileTransform[0][0]);
+            glUniform4fv(glGetUniformLocation(shader.ID, "uShadowTileRects"), tileCount, &tileRect[0][0]);
+        }
+    }
+
+private:
+    struct Layer {
+        GLuint FBO = 0;
+        GLuint depth = 0;
+    };
+
+    bool created = false;
+    bool staticValid = false;
+    int staticSize = 4096, dynamicSize = 2048;
+    Layer staticLayer, dynamicLayer;
+
+    glm::vec4 lightKey[2] = {};
+    glm::vec3 lightDirection = glm::vec3(0.0f, -1.0f, 0.0f);
+    glm::vec4 sceneSphere = glm::vec4(0.0f, 0.0f, 0.0f, 1.0f);     // from setLight, xyz center, w radius
+    glm::mat4 staticSpace = glm::mat4(1.0f);
+    glm::mat4 dynamicSpace = glm::mat4(1.0f);   // light view x/y unscaled, depth over the scene
+
+    // dynamic atlas, tileGrid x tileGrid tiles of tilePixels
+    unsigned int tileCount = 0, tileGrid = 1;
+    int tilePixels = 2048;
+    glm::mat4 tileSpace[maxDynamicTiles];
+    glm::vec4 tileTransform[maxDynamicTiles];   // light view x/y -> atlas uv: xy offset, z scale
+    glm::vec4 tileRect[maxDynamicTiles];        // atlas uv the tile may be sampled in, min xy, max zw
+
+    GLint previousFramebuffer = 0;
+    GLint previousViewport[4] = {};
+
+    static bool createLayer(Layer& layer, int size)
+    {
+        glGenTextures(1, &layer.depth);
+        glBindTexture(GL_TEXTURE_2D, layer.depth);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, size, size, 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        // outside the map counts as lit
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        float border[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+        glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
+        // hardware comparison + bilinear PCF through sampler2DShadow
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+        glBindTexture(GL_TEXTURE_2D, 0);
+
+        glGenFramebuffers(1, &layer.FBO);
+        glBindFramebuffer(GL_FRAMEBUFFER, layer.FBO);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, layer.depth, 0);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        return complete;
+    }
+
+    static void releaseLayer(Layer& layer)
+    {
+        if (layer.FBO) glDeleteFramebuffers(1, &layer.FBO);
+        if (layer.depth) glDeleteTextures(1, &layer.depth);
+        layer.FBO = 0;
+        layer.depth = 0;
+    }
+
+    // orthographic light view around a sphere, snapped to whole texels so the map doesn't shimmer when the
+    // sphere moves
+    glm::mat4 fit(const glm::vec3& center, float radius, int size) const
+    {
+        glm::mat4 view = lightView();
+
+        glm::vec3 c = glm::vec3(view * glm::vec4(center, 1.0f));
+        float texel = 2.0f * radius / size;
+        c.x = std::floor(c.x / texel) * texel;
+        c.y = std::floor(c.y / texel) * texel;
+
+        glm::mat4 projection = glm::ortho(c.x - radius, c.x + radius, c.y - radius, c.y + radius, -c.z - radius, -c.z + radius);
+        return projection * view;
+    }
+
+    glm::mat4 lightView() const
+    {
+        glm::vec3 up = std::fabs(lightDirection.y) > 0.99f ? glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+        return glm::lookAt(-lightDirection, glm::vec3(0.0f), up);
+    }
+
+    void begin(const Layer& layer, int size, const glm::mat4& lightSpace, Shader& shadowShader)
+    {
+        glGetIntegerv(GL_FRAMEBUFFER_BINDING, &previousFramebuffer);
+        glGetIntegerv(GL_VIEWPORT, previousViewport);
+
+        glBindFramebuffer(GL_FRAMEBUFFER, layer.FBO);
+        glViewport(0, 0, size, size);
+        glClear(GL_DEPTH_BUFFER_BIT);
+        // slope scaled bias against acne, the shader adds no constant bias of its own
+        glEnable(GL_POLYGON_OFFSET_FILL);
+        glPolygonOffset(2.0f, 4.0f);
+
+        shadowShader.use();
+        shadowShader.setMat4("uLightSpace", lightSpace);
+    }
+};
+
+#endif
@@ -0,0 +1,187 @@
+#ifndef STREAMING_H
+#define STREAMING_H
+
+#include <GL/glew.h>
+
+#include "model.hpp"
+#include "memstats.hpp"
+
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Rider models loaded on demand. A model is imported and its textures decoded on a worker thread the first
+// time a seat needs it, the GL objects are created on the render thread once the import is done, and models
+// nobody sits in are evicted least recently used first whenever the resident ones go over the budget.
+// Until a model is resident its riders are simply not drawn.
+class ModelStreamer
+{
+public:
+    // resident bytes the streamer tries to stay under, models in use are never evicted so this can be exceeded
+    size_t cpuBudget = (size_t)128 * 1024 * 1024;
+    size_t gpuBudget = (size_t)256 * 1024 * 1024;
+    // update() waits for running loads, so a rider shows up on the same frame in every run (headless, replays)
+    bool synchronous = false;
+    // drop the CPU copy of the geometry after upload (--release-geometry)
+    bool releaseGeometry = false;
+
+    void setPaths(const std::vector<std::string>& paths)
+    {
+        slots.resize(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) slots[i].path = paths[i];
+    }
+
+    unsigned int count() const { return (unsigned int)slots.size(); }
+
+    // starts loading a model in the background, nothing if it is loading or loaded
+    void request(unsigned int index)
+    {
+        Slot& slot = slots[index];
+        if (slot.state != UNLOADED) return;
+
+        std::string path = slot.path;
+        slot.pending = std::async(std::launch::async, [path]() {
+            return std::unique_ptr<Model>(new Model(path, false, false));
+        });
+        slot.state = LOADING;
+        slot.requested = std::chrono::steady_clock::now();
+    }
+
+    // loads everything now and keeps it resident. The indirect renderer pools geometry once at build.
+    void loadAll()
+    {
+        for (unsigned int i = 0; i < slots.size(); i++) {
+            request(i);
+            slots[i].pending.wait();
+            slots[i].pinned = true;
+        }
+        update();
+    }
+
+    // the model is needed this frame (a rider sits in it), starts loading it if needed
+    void touch(unsigned int index)
+    {
+        request(index);
+        slots[index].lastUsed = frame;
+    }
+
+    // the model if it is on the GPU, nullptr while it is still loading
+    Model* get(unsigned int index)
+    {
+        Slot& slot = slots[index];
+        return slot.state == RESIDENT ? slot.model.get() : nullptr;
+    }
+
+    // render thread, once per frame after touch(): uploads finished imports, evicts over the budget
+    void update()
+    {
+        for (Slot& slot : slots) {
+            if (slot.state != LOADING) continue;
+            if (synchronous) slot.pending.wait();
+            if (slot.pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready) continue;
+            slot.model = slot.pending.get();
+            slot.model->upload();
+            if (releaseGeometry) slot.model->releaseGeometry();
+            measure(slot);
+            slot.state = RESIDENT;
+            slot.lastUsed = frame;
+            cpuResident += slot.cpuBytes;
+            gpuResident += slot.gpuBytes;
+            double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - slot.requested).count();
+            std::cout << "Riders: loaded " << slot.path << " in " << (int)ms << " ms (" << megabytes(slot.cpuBytes) << " MB CPU, "
+                      << megabytes(slot.gpuBytes) << " MB GPU), resident " << megabytes(cpuResident) << " / "
+                      << megabytes(gpuResident) << " MB\n";
+        }
+
+        while (cpuResident > cpuBudget || gpuResident > gpuBudget) {
+            Slot* victim = nullptr;
+            for (Slot& slot : slots) {
+                if (slot.state != RESIDENT || slot.pinned || slot.lastUsed == frame) continue;
+                if (!victim || slot.lastUsed < victim->lastUsed) victim = &slot;
+            }
+            if (!victim) break;
+            evict(*victim);
+        }
+        frame++;
+    }
+
+    size_t cpuBytes() const { return cpuResident; }
+    size_t gpuBytes() const { return gpuResident; }
+
+    // resident models for a memory report
+    void report(MemoryReport& memory) const
+    {
+        for (const Slot& slot : slots)
+            if (slot.state == RESIDENT) memory.add(slot.path, *slot.model);
+    }
+
+    // a model is being imported (worker threads allocate)
+    bool loading() const
+    {
+        for (const Slot& slot : slots)
+            if (slot.state == LOADING) return true;
+        return false;
+    }
+
+    unsigned int residentCount() const
+    {
+        unsigned int n = 0;
+        for (const Slot& slot : slots) n += slot.state == RESIDENT ? 1 : 0;
+        return n;
+    }
+
+    // waits for loads still running, needs a current context
+    void release()
+    {
+        for (Slot& slot : slots) {
+            if (slot.state == LOADING) slot.pending.wait();
+            if (slot.state == RESIDENT) evict(slot);
+            slot.pending = std::future<std::unique_ptr<Model>>();
+            slot.model.reset();
+            slot.state = UNLOADED;
+        }
+    }
+
+private:
+    enum State { UNLOADED, LOADING, RESIDENT };
+
+    struct Slot {
+        std::string path;
+        State state = UNLOADED;
+        bool pinned = false;
+        std::future<std::unique_ptr<Model>> pending;
+        std::unique_ptr<Model> model;
+        std::chrono::steady_clock::time_point requested;
+        unsigned long long lastUsed = 0;
+        size_t cpuBytes = 0, gpuBytes = 0;
+    };
+
+    std::vector<Slot> slots;
+    unsigned long long frame = 1;
+    size_t cpuResident = 0, gpuResident = 0;
+
+    void evict(Slot& slot)
+    {
+        slot.model->release();
+        slot.model.reset();
+        slot.state = UNLOADED;
+        cpuResident -= slot.cpuBytes;
+        gpuResident -= slot.gpuBytes;
+        std::cout << "Riders: evicted " << slot.path << ", resident " << megabytes(cpuResident) << " / "
+                  << megabytes(gpuResident) << " MB\n";
+    }
+
+    static void measure(Slot& slot)
+    {
+        MemoryStats stats = modelMemory(*slot.model);
+        slot.cpuBytes = stats.cpuGeometry;
+        slot.gpuBytes = stats.gpu();
+    }
+
+    static double megabytes(size_t bytes) { return (int)(bytes * 10 / (1024 * 1024)) / 10.0; }
+};
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TRACK_H
+#define TRACK_H
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Track path and car placement. Kept free of GL so the benchmarks (bench/) can run the same code.
+
+// vertices of one rail part in res/tracks.obj, each part becomes one key point
+const int trackVerticesPerPart = 382;
+
+//cita iz obj fajla vertexe
+inline bool loadTrackVertices(const std::string& path, std::vector<glm::vec3>& rawVertices) {
+    std::ifstream file(path);
+    if (!file.is_open()) return false;
+    rawVertices.clear();
+    std::string line;
+    while (std::getline(file, line)) {
+        std::stringstream ss(line);
+        std::string prefix;
+        ss >> prefix;
+        if (prefix == "v") {
+            float x, y, z;
+            ss >> x >> y >> z;
+            rawVertices.push_back(glm::vec3(x, y, z));
+        }
+    }
+    file.close();
+    return true;
+}
+
+//kreira centoride, pravi zatvrorenu putanju
+inline void generateKeyPoints(const std::vector<glm::vec3>& rawVertices, std::vector<glm::vec3>& keyPoints, std::vector<glm::vec3>& sortedPoints) {
+    keyPoints.clear();
+    sortedPoints.clear();
+    int maxVertices = rawVertices.size();
+
+    for (int i = 0; i < maxVertices; i += trackVerticesPerPart) {
+        glm::vec3 sum(0.0f);
+        int count = 0;
+        for (int j = 0; j < trackVerticesPerPart && (i + j) < maxVertices; ++j) {
+            sum += rawVertices[i + j];
+            count++;
+        }
+        if (count > 0) keyPoints.push_back(sum / (float)count);
+    }
+
+    if (keyPoints.empty()) return;
+
+    std::vector<bool> visited(keyPoints.size(), false);
+
+    glm::vec3 current = keyPoints[0];
+    sortedPoints.push_back(current);
+    visited[0] = true;
+
+    for (size_t i = 1; i < keyPoints.size(); ++i) {
+        float minDist = 1000000.0f;
+        int nextIdx = -1;
+
+        for (size_t j = 0; j < keyPoints.size(); ++j) {
+            if (!visited[j]) {
+                float d = glm::distance(current, keyPoints[j]);
+                if (d < minDist) {
+                    minDist = d;
+                    nextIdx = (int)j;
+                }
+            }
+        }
+
+        if (nextIdx != -1) {
+            visited[nextIdx] = true;
+            current = keyPoints[nextIdx];
+            sortedPoints.push_back(current);
+        }
+    }
+}
+
+inline std::pair<glm::vec3, glm::vec3> getCarPosition(const std::vector<glm::vec3>& points, float t) {
+    int n = points.size();
+    int i0 = (int)(t * n);
+    int i1 = (i0 + 1) % n;
+    float alpha = t * n - i0;
+
+    glm::vec3 pos = glm::mix(points[i0], points[i1], alpha);
+    glm::vec3 forward = glm::normalize(points[i1] - points[i0]);
+    return { pos, forward };
+}
+
+// orijentacija auta iz pravca kretanja
+inline glm::mat4 carRotationMatrix(const glm::vec3& carFront) {
+    glm::vec3 worldUp = glm::vec3(0.0f, 1.0f, 0.0f);
+    glm::vec3 right = glm::normalize(glm::cross(worldUp, carFront));
+    glm::vec3 up = glm::cross(carFront, right);
+
+    glm::mat4 rotationMatrix = glm::mat4(1.0f);
+    rotationMatrix[0] = glm::vec4(right, 0.0f);
+    rotationMatrix[1] = glm::vec4(up, 0.0f);
+    rotationMatrix[2] = glm::vec4(-carFront, 0.0f);
+    return rotationMatrix;
+}
+
+// model matrica putnika: sediste u autu, pa pomeraj i skala modela
+inline glm::mat4 passengerMatrix(const glm::vec3& carPosition, const glm::mat4& rotationMatrix, const glm::mat4& passengerRotation,
+                                 const glm::vec3& seatOffset, const glm::vec3& modelOffset, float modelScale) {
+    glm::mat4 modelPassenger = glm::mat4(1.0f);
+    modelPassenger = glm::translate(modelPassenger, carPosition);
+    modelPassenger = modelPassenger * rotationMatrix;
+    modelPassenger = modelPassenger * passengerRotation;
+
+    modelPassenger = glm::translate(modelPassenger, seatOffset);
+    modelPassenger = modelPassenger * rotationMatrix;
+    modelPassenger = glm::translate(modelPassenger, modelOffset);
+    modelPassenger = glm::scale(modelPassenger, glm::vec3(modelScale));
+    return modelPassenger;
+}
+
+#endif
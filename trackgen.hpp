@@ -0,0 +1,335 @@
+#ifndef TRACKGEN_H
+#define TRACKGEN_H
+
+#include <GL/glew.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/constants.hpp>
+
+#include "mesh.hpp"
+#include "shader.hpp"
+#include "profiler.hpp"
+
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Procedural track: the asset is only a list of centreline control points (.track), the geometry is
+// generated at load instead of importing the pre-modelled tracks.obj.
+//
+// Control point file, one point per line, '#' starts a comment:
+//   p <x> <y> <z>
+// The closed Catmull-Rom spline through the points is sampled into the key point path the trains follow.
+// Rails and spine are cross-section rings swept along that path into one mesh. Ties and supports are the
+// same small box / cylinder repeated hundreds of times, so they are stored once and drawn instanced with a
+// per instance model matrix (basic.vert / shadow.vert with INSTANCED).
+
+// sizes in track units, the car sits carOffset above the centreline
+struct TrackShape {
+    int samplesPerSegment = 8;      // path points per control point segment
+    float gauge = 1.2f;             // distance between the rails
+    float railRadius = 0.07f;
+    float spineRadius = 0.16f;
+    float spineDrop = 0.35f;        // spine centre below the rails
+    int ringSides = 8;
+    float tieSpacing = 1.0f;
+    float supportSpacing = 9.0f;
+    float supportRadius = 0.18f;
+    float minSupportHeight = 1.0f;  // no support where the track is this close to the ground
+};
+
+inline bool isProceduralTrack(const std::string& path) {
+    return path.size() > 6 && path.compare(path.size() - 6, 6, ".track") == 0;
+}
+
+inline bool loadControlPoints(const std::string& path, std::vector<glm::vec3>& points) {
+    std::ifstream file(path);
+    if (!file.is_open()) {
+        std::cout << "ERROR::TRACKGEN:: can't read " << path << std::endl;
+        return false;
+    }
+    points.clear();
+    std::string line;
+    int lineNumber = 0;
+    while (std::getline(file, line)) {
+        lineNumber++;
+        line = line.substr(0, line.find('#'));
+        std::stringstream ss(line);
+        std::string type;
+        if (!(ss >> type)) continue;
+        glm::vec3 p;
+        if (type == "p" && (ss >> p.x >> p.y >> p.z)) points.push_back(p);
+        else std::cout << "ERROR::TRACKGEN:: " << path << ":" << lineNumber << " expected 'p x y z'" << std::endl;
+    }
+    if (points.size() < 4) {
+        std::cout << "ERROR::TRACKGEN:: " << path << " needs at least 4 control points" << std::endl;
+        return false;
+    }
+    return true;
+}
+
+// for --export-track: key points of an existing track obj become the control points
+inline bool writeControlPoints(const std::string& path, const std::vector<glm::vec3>& points, const std::string& source) {
+    std::ofstream out(path);
+    if (!out.is_open()) {
+        std::cout << "ERROR::TRACKGEN:: can't write " << path << std::endl;
+        return false;
+    }
+    out << "# " << points.size() << " control points from " << source << "\n";
+    for (const glm::vec3& p : points)
+        out << "p " << p.x << " " << p.y << " " << p.z << "\n";
+    return true;
+}
+
+// closed uniform Catmull-Rom through the control points
+inline void sampleCentreline(const std::vector<glm::vec3>& control, int samplesPerSegment, std::vector<glm::vec3>& path) {
+    int n = (int)control.size();
+    path.clear();
+    path.reserve((size_t)n * samplesPerSegment);
+    for (int i = 0; i < n; i++) {
+        const glm::vec3& p0 = control[(i + n - 1) % n];
+        const glm::vec3& p1 = control[i];
+        const glm::vec3& p2 = control[(i + 1) % n];
+        const glm::vec3& p3 = control[(i + 2) % n];
+        for (int s = 0; s < samplesPerSegment; s++) {
+            float t = (float)s / samplesPerSegment;
+            float t2 = t * t, t3 = t2 * t;
+            path.push_back(0.5f * (2.0f * p1 + (p2 - p0) * t + (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3) * t2 +
+                                   (3.0f * p1 - p0 - 3.0f * p2 + p3) * t3));
+        }
+    }
+}
+
+// right / up / forward at a path point, the same frame carRotationMatrix gives the car
+inline void trackFrame(const std::vector<glm::vec3>& path, size_t i, glm::vec3& right, glm::vec3& up, glm::vec3& forward) {
+    size_t n = path.size();
+    forward = glm::normalize(path[(i + 1) % n] - path[(i + n - 1) % n]);
+    right = glm::normalize(glm::cross(glm::vec3(0.0f, 1.0f, 0.0f), forward));
+    up = glm::cross(forward, right);
+}
+
+// one closed tube of 'radius' at 'offset' (right, up) from the centreline, appended to vertices/indices
+inline void sweepTube(const std::vector<glm::vec3>& path, const glm::vec2& offset, float radius, int sides,
+                      std::vector<Vertex>& vertices, std::vector<unsigned int>& indices) {
+    unsigned int n = (unsigned int)path.size();
+    unsigned int first = (unsigned int)vertices.size();
+    float along = 0.0f;
+    for (unsigned int i = 0; i < n; i++) {
+        glm::vec3 right, up, forward;
+        trackFrame(path, i, right, up, forward);
+        glm::vec3 center = path[i] + right * offset.x + up * offset.y;
+        if (i > 0) along += glm::distance(path[i], path[i - 1]);
+        for (int s = 0; s < sides; s++) {
+            float a = glm::two_pi<float>() * s / sides;
+            Vertex v;
+            v.Normal = right * std::cos(a) + up * std::sin(a);
+            v.Position = center + v.Normal * radius;
+            v.TexCoords = glm::vec2((float)s / sides, along * 0.25f);
+            vertices.push_back(v);
+        }
+    }
+    for (unsigned int i = 0; i < n; i++) {
+        unsigned int ring = first + i * sides, next = first + ((i + 1) % n) * sides;
+        for (int s = 0; s < sides; s++) {
+            unsigned int s1 = (s + 1) % sides;
+            indices.insert(indices.end(), { ring + s, next + s1, next + s, ring + s, ring + s1, next + s1 });
+        }
+    }
+}
+
+inline Bounds boundsOf(const std::vector<Vertex>& vertices) {
+    Bounds b;
+    if (vertices.empty()) return b;
+    b.min = b.max = vertices[0].Position;
+    for (const Vertex& v : vertices) {
+        b.min = glm::min(b.min, v.Position);
+        b.max = glm::max(b.max, v.Position);
+    }
+    b.center = (b.min + b.max) * 0.5f;
+    for (const Vertex& v : vertices)
+        b.radius = glm::max(b.radius, glm::distance(b.center, v.Position));
+    return b;
+}
+
+// rails and spine of a local space path as one mesh
+inline Mesh buildTrackMesh(const std::vector<glm::vec3>& path, const TrackShape& shape, const std::vector<Texture>& textures) {
+    PROFILE_SCOPE("buildTrackMesh");
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    vertices.reserve(path.size() * shape.ringSides * 3);
+    indices.reserve(path.size() * shape.ringSides * 18);
+    sweepTube(path, glm::vec2(-0.5f * shape.gauge, 0.0f), shape.railRadius, shape.ringSides, vertices, indices);
+    sweepTube(path, glm::vec2(0.5f * shape.gauge, 0.0f), shape.railRadius, shape.ringSides, vertices, indices);
+    sweepTube(path, glm::vec2(0.0f, -shape.spineDrop), shape.spineRadius, shape.ringSides, vertices, indices);
+    Bounds bounds = boundsOf(vertices);
+    return Mesh(vertices, indices, textures, bounds);
+}
+
+// instance matrices of a world space path: ties across the rails every tieSpacing, supports from the
+// ground (y = 0) up to the spine every supportSpacing. 'scale' is the track's scale, the unit meshes are
+// sized in track units.
+inline void trackInstances(const std::vector<glm::vec3>& path, float scale, const TrackShape& shape,
+                           std::vector<glm::mat4>& ties, std::vector<glm::mat4>& supports) {
+    float sinceTie = shape.tieSpacing, sinceSupport = shape.supportSpacing;
+    for (size_t i = 0; i < path.size(); i++) {
+        float step = i > 0 ? glm::distance(path[i], path[i - 1]) / scale : 0.0f;
+        sinceTie += step;
+        sinceSupport += step;
+
+        glm::vec3 right, up, forward;
+        trackFrame(path, i, right, up, forward);
+        if (sinceTie >= shape.tieSpacing) {
+            sinceTie = 0.0f;
+            glm::mat4 m(1.0f);
+            m[0] = glm::vec4(right * scale, 0.0f);
+            m[1] = glm::vec4(up * scale, 0.0f);
+            m[2] = glm::vec4(forward * scale, 0.0f);
+            m[3] = glm::vec4(path[i], 1.0f);
+            ties.push_back(m);
+        }
+        glm::vec3 spine = path[i] - up * (shape.spineDrop * scale);
+        if (sinceSupport >= shape.supportSpacing && spine.y > shape.minSupportHeight * scale) {
+            sinceSupport = 0.0f;
+            glm::mat4 m = glm::translate(glm::mat4(1.0f), glm::vec3(spine.x, 0.0f, spine.z));
+            supports.push_back(glm::scale(m, glm::vec3(shape.supportRadius * scale, spine.y, shape.supportRadius * scale)));
+        }
+    }
+}
+
+// tie: box across the rails, in the frame of trackInstances (x right, y up, z forward)
+inline Mesh unitTie(const TrackShape& shape, const std::vector<Texture>& textures) {
+    glm::vec3 half(0.5f * shape.gauge + shape.railRadius, 0.04f, 0.08f);
+    glm::vec3 center(0.0f, -shape.railRadius - half.y, 0.0f);
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (int axis = 0; axis < 3; axis++) {
+        for (int sign = -1; sign <= 1; sign += 2) {
+            glm::vec3 normal(0.0f);
+            normal[axis] = (float)sign;
+            glm::vec3 u(0.0f), v(0.0f);
+            u[(axis + 1) % 3] = 1.0f;
+            v[(axis + 2) % 3] = 1.0f;
+            if (sign < 0) std::swap(u, v);
+            unsigned int base = (unsigned int)vertices.size();
+            for (int c = 0; c < 4; c++) {
+                float su = (c == 1 || c == 2) ? 1.0f : -1.0f, sv = c >= 2 ? 1.0f : -1.0f;
+                Vertex vertex;
+                vertex.Position = center + half * (normal + su * u + sv * v);
+                vertex.Normal = normal;
+                vertex.TexCoords = glm::vec2(su * 0.5f + 0.5f, sv * 0.5f + 0.5f);
+                vertices.push_back(vertex);
+            }
+            indices.insert(indices.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+        }
+    }
+    return Mesh(vertices, indices, textures, boundsOf(vertices));
+}
+
+// support: open cylinder of radius 1 from y = 0 to y = 1, scaled per instance
+inline Mesh unitSupport(int sides, const std::vector<Texture>& textures) {
+    std::vector<Vertex> vertices;
+    std::vector<unsigned int> indices;
+    for (int s = 0; s <= sides; s++) {
+        float a = glm::two_pi<float>() * s / sides;
+        glm::vec3 normal(std::cos(a), 0.0f, std::sin(a));
+        for (int y = 0; y < 2; y++) {
+            Vertex v;
+            v.Position = normal + glm::vec3(0.0f, (float)y, 0.0f);
+            v.Normal = normal;
+            v.TexCoords = glm::vec2((float)s / sides, (float)y);
+            vertices.push_back(v);
+        }
+    }
+    for (unsigned int s = 0; s < (unsigned int)sides; s++) {
+        unsigned int b = s * 2;
+        indices.insert(indices.end(), { b, b + 1, b + 3, b, b + 3, b + 2 });
+    }
+    return Mesh(vertices, indices, textures, boundsOf(vertices));
+}
+
+// ties and supports of every procedural track, one instanced draw each
+class TrackInstances
+{
+public:
+    std::vector<glm::mat4> ties, supports;     // world space, filled before create()
+
+    // needs a current context
+    void create(const TrackShape& shape, const std::vector<Texture>& textures)
+    {
+        if (ties.empty() && supports.empty()) return;
+        parts.push_back(Part{ unitTie(shape, textures), 0, (unsigned int)ties.size() });
+        parts.push_back(Part{ unitSupport(shape.ringSides, textures), 0, (unsigned int)supports.size() });
+        attach(parts[0], ties);
+        attach(parts[1], supports);
+    }
+
+    bool ready() const { return !parts.empty(); }
+
+    // unit meshes and instance matrices
+    size_t bufferBytes() const
+    {
+        size_t bytes = 0;
+        for (const Part& part : parts)
+            bytes += (size_t)part.mesh.vertexCount * (sizeof(Vertex) + sizeof(glm::vec3)) + (size_t)part.mesh.indexCount * sizeof(unsigned int)
+                   + (size_t)part.count * sizeof(glm::mat4);
+        return bytes;
+    }
+
+    unsigned int instanceCount() const { return (unsigned int)(ties.size() + supports.size()); }
+
+    // shader compiled with INSTANCED
+    void draw(Shader& shader)
+    {
+        PROFILE_SCOPE("TrackInstances::draw");
+        for (Part& part : parts)
+            if (part.count) part.mesh.DrawInstanced(shader, part.count);
+    }
+
+    // depth only, shadow.vert with INSTANCED
+    void drawDepth()
+    {
+        for (Part& part : parts)
+            if (part.count) part.mesh.DrawDepthInstanced(part.count);
+    }
+
+    void release()
+    {
+        for (Part& part : parts)
+            if (part.instanceVBO) glDeleteBuffers(1, &part.instanceVBO);
+        parts.clear();
+    }
+
+private:
+    struct Part {
+        Mesh mesh;
+        GLuint instanceVBO;
+        unsigned int count;
+    };
+    std::vector<Part> parts;
+
+    // per instance mat4 at locations 3-6 of both VAOs of the mesh
+    static void attach(Part& part, const std::vector<glm::mat4>& matrices)
+    {
+        if (matrices.empty()) return;
+        glGenBuffers(1, &part.instanceVBO);
+        glBindBuffer(GL_ARRAY_BUFFER, part.instanceVBO);
+        glBufferData(GL_ARRAY_BUFFER, matrices.size() * sizeof(glm::mat4), &matrices[0], GL_STATIC_DRAW);
+        GLuint vaos[2] = { part.mesh.VAO, part.mesh.depthVAO };
+        for (GLuint vao : vaos) {
+            glBindVertexArray(vao);
+            for (int c = 0; c < 4; c++) {
+                glEnableVertexAttribArray(3 + c);
+                glVertexAttribPointer(3 + c, 4, GL_FLOAT, GL_FALSE, sizeof(glm::mat4), (void*)(sizeof(glm::vec4) * c));
+                glVertexAttribDivisor(3 + c, 1);
+            }
+        }
+        glBindVertexArray(0);
+        glBindBuffer(GL_ARRAY_BUFFER, 0);
+    }
+};
+
+#endif
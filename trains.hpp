@@ -0,0 +1,241 @@
+#ifndef TRAINS_H
+#define TRAINS_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+//stanja auta
+enum CarState { MOVING, SLOWING_DOWN, RETURNING, STOPPED, WAITING };
+
+// ride tuning, same numbers the single car used
+struct RideParams {
+    float minSpeed = 0.05f;
+    float maxSpeed = 0.50f;
+    float gravityFactor = 9.7f;
+    float brake = 0.1f;         // SLOWING_DOWN deceleration
+    float waitTime = 10.0f;     // WAITING before the car rolls back to the station
+    float returnSpeed = 0.1f;
+};
+
+// Every train on one track, structure of arrays. Train 0 is the rider train driven by the keyboard,
+// the rest circle the track in MOVING.
+//
+// The track parameter t in [0, 1) is split into equal block sections. A train owns the blocks under its
+// head and tail (blocks are never shorter than a train, so at most two) and may only move its head into a
+// block that is free. Each update is O(trains) with O(1) work per train, nothing is allocated after init().
+//
+// Trains only ever move forward through blocks, so with at least one free block on the loop somebody can
+// always move. A lone rider train rolls back to the station after stopping (RETURNING) like it always did;
+// with other trains on the circuit that would mean backing into the train behind it, so it instead
+// finishes the lap at return speed and stops when it reaches the station (t wraps to 0).
+class TrainManager
+{
+public:
+    // per train state
+    std::vector<float> t;               // parametar napredovanja, head of the train
+    std::vector<float> speed;
+    std::vector<float> waitTimer;
+    std::vector<CarState> state;
+    std::vector<glm::vec3> position;    // head position / direction on the path
+    std::vector<glm::vec3> front;
+    std::vector<int> headBlock, tailBlock;
+    std::vector<unsigned char> held;    // stopped this frame by the block system
+
+    RideParams params;
+
+    // every MOVING train stops at the station (t wraps to 0) and waits in STOPPED until it is dispatched,
+    // the guest flow simulation (guestflow.hpp) runs the whole fleet like this
+    bool stationStops = false;
+
+    // 'trainLength' is in world units. The block count is reduced if blocks would be shorter than a train,
+    // the train count if there are fewer than two blocks per train.
+    void init(const std::vector<glm::vec3>& path, unsigned int trainCount, unsigned int requestedBlocks, float trainLength = 3.0f)
+    {
+        points = &path;
+
+        float pathLength = 0.0f;
+        for (size_t i = 0; i < path.size(); i++)
+            pathLength += glm::distance(path[i], path[(i + 1) % path.size()]);
+
+        length = pathLength > 0.0f ? trainLength / pathLength : 0.0f;
+        unsigned int maxBlocks = length > 0.0f ? (unsigned int)(1.0f / length) : requestedBlocks;
+        blockCount = std::max(1u, std::min(requestedBlocks, maxBlocks));
+        trainCount = std::max(1u, std::min(trainCount, std::max(1u, blockCount / 2)));
+
+        blockOwner.assign(blockCount, -1);
+
+        t.assign(trainCount, 0.0f);
+        speed.assign(trainCount, 0.0f);
+        waitTimer.assign(trainCount, 0.0f);
+        state.assign(trainCount, MOVING);
+        position.assign(trainCount, path.empty() ? glm::vec3(1.0f) : path[0]);
+        front.assign(trainCount, glm::vec3(0.0f, 0.0f, 1.0f));
+        headBlock.assign(trainCount, -1);
+        tailBlock.assign(trainCount, -1);
+        held.assign(trainCount, 0);
+
+        state[0] = STOPPED;
+        speed[0] = 0.01f;
+
+        // the others start evenly spaced, each at the start of a block so nobody overlaps
+        for (unsigned int i = 1; i < trainCount; i++) {
+            unsigned int block = i * blockCount / trainCount;
+            t[i] = (float)block / blockCount + length;
+            speed[i] = params.minSpeed;
+        }
+        for (unsigned int i = 0; i < trainCount; i++) {
+            claim(i, blockOf(t[i]), blockOf(t[i] - length), true);
+            place(i);
+        }
+    }
+
+    unsigned int count() const { return (unsigned int)t.size(); }
+    unsigned int blocks() const { return blockCount; }
+
+    // blocks currently owned, for the debug print
+    unsigned int occupiedBlocks() const
+    {
+        unsigned int n = 0;
+        for (int owner : blockOwner) n += owner >= 0 ? 1 : 0;
+        return n;
+    }
+
+    void update(float deltaTime)
+    {
+        if (!points || points->empty()) return;
+        for (unsigned int i = 0; i < count(); i++)
+            step(i, deltaTime);
+    }
+
+private:
+    const std::vector<glm::vec3>* points = nullptr;
+    float length = 0.0f;                // train length in t units
+    unsigned int blockCount = 1;
+    std::vector<int> blockOwner;        // train index per block, -1 = free
+
+    int blockOf(float u) const
+    {
+        u -= std::floor(u);
+        return std::min((int)(u * blockCount), (int)blockCount - 1);
+    }
+
+    static float wrap(float u)
+    {
+        if (u >= 1.0f) u -= std::floor(u);
+        if (u < 0.0f) u += 1.0f;
+        return u;
+    }
+
+    void step(unsigned int i, float deltaTime)
+    {
+        const std::vector<glm::vec3>& path = *points;
+
+        // indeksi za interpolaciju
+        int n = path.size();
+        int i0 = (int)(t[i] * n);
+        int i1 = (i0 + 1) % n;
+
+        // nagib i ubrzanje
+        float dy = path[i1].y - path[i0].y;
+        float acc = -dy * params.gravityFactor;
+
+        float move = 0.0f;     // signed distance in t this frame
+        bool arriving = false;  // RETURNING lap ends at the station this frame
+        switch (state[i]) {
+        case MOVING:
+            speed[i] += acc * deltaTime;
+            speed[i] = glm::clamp(speed[i], params.minSpeed, params.maxSpeed);
+            move = speed[i] * deltaTime;
+            break;
+        case SLOWING_DOWN:
+            speed[i] -= params.brake * deltaTime;
+            if (speed[i] <= 0.0f) { speed[i] = 0.0f; state[i] = WAITING; waitTimer[i] = 0.0f; }
+            else move = speed[i] * deltaTime;
+            break;
+        case WAITING:
+            waitTimer[i] += deltaTime;
+            if (waitTimer[i] >= params.waitTime) {
+                speed[i] = params.returnSpeed;
+                state[i] = RETURNING;
+            }
+            break;
+        case RETURNING:
+            if (count() == 1) {
+                move = -speed[i] * deltaTime;
+                if (t[i] + move <= 0.0f) { move = -t[i]; state[i] = STOPPED; speed[i] = 0.0f; }
+            }
+            else {
+                move = speed[i] * deltaTime;
+                if (t[i] + move >= 1.0f) { move = 1.0f - t[i]; arriving = true; }
+            }
+            break;
+        case STOPPED:
+            speed[i] = 0.0f;
+            break;
+        }
+
+        held[i] = 0;
+        bool wrapped = false;
+        if (move > 0.0f) {
+            float next = t[i] + move;
+            // a fast train can cross more than one block in a frame, every one on the way has to be free
+            int target = blockOf(next);
+            for (int block = headBlock[i]; block != target; ) {
+                int ahead = (block + 1) % (int)blockCount;
+                if (blockOwner[ahead] >= 0 && blockOwner[ahead] != (int)i) {
+                    // taken, stop just before its boundary
+                    float boundary = (float)(block + 1) / blockCount;
+                    if (boundary < t[i]) boundary += 1.0f;
+                    next = std::max(t[i], boundary - 1e-5f);
+                    held[i] = 1;
+                    break;
+                }
+                block = ahead;
+            }
+            wrapped = next >= 1.0f;
+            t[i] = wrap(next);
+        }
+        else if (move < 0.0f) {
+            t[i] = wrap(t[i] + move);
+        }
+
+        // reached the station: wrapped means the head got past t = 0, so block 0 was free and is now ours
+        if (stationStops && wrapped && state[i] == MOVING) { t[i] = 0.0f; state[i] = STOPPED; speed[i] = 0.0f; }
+        else if (held[i]) speed[i] = std::min(speed[i], params.minSpeed);
+        else if (arriving) { t[i] = 0.0f; state[i] = STOPPED; speed[i] = 0.0f; }
+        claim(i, blockOf(t[i]), blockOf(t[i] - length), false);
+        place(i);
+    }
+
+    // hands back blocks the train left and takes the ones it now covers
+    void claim(unsigned int i, int head, int tail, bool force)
+    {
+        int oldBlocks[2] = { headBlock[i], tailBlock[i] };
+        for (int b : oldBlocks)
+            if (b >= 0 && b != head && b != tail && blockOwner[b] == (int)i) blockOwner[b] = -1;
+
+        if (force || blockOwner[head] < 0) blockOwner[head] = i;
+        if (force || blockOwner[tail] < 0) blockOwner[tail] = i;
+        headBlock[i] = head;
+        tailBlock[i] = tail;
+    }
+
+    void place(unsigned int i)
+    {
+        const std::vector<glm::vec3>& path = *points;
+        if (path.empty()) return;
+
+        int n = path.size();
+        int i0 = (int)(t[i] * n);
+        int i1 = (i0 + 1) % n;
+        float alpha = t[i] * n - i0;
+
+        position[i] = glm::mix(path[i0], path[i1], alpha);
+        front[i] = glm::normalize(path[i1] - path[i0]);
+    }
+};
+
+#endif
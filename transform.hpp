@@ -0,0 +1,83 @@
+#ifndef TRANSFORM_H
+#define TRANSFORM_H
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// Flat transform hierarchy: local and world matrices in contiguous arrays, every node added after its
+// parent, so one forward pass is a valid topological order. setLocal() only marks the node, update()
+// recomputes the marked nodes and everything under them and leaves the rest alone. The world array can be
+// handed to glBufferSubData / the indirect renderer as instance data as is.
+class TransformHierarchy
+{
+public:
+    // returns the node index, 'parent' is -1 for a root and must already exist
+    int add(int parent, const glm::mat4& local = glm::mat4(1.0f))
+    {
+        int index = (int)locals.size();
+        parents.push_back(parent);
+        locals.push_back(local);
+        worlds.push_back(local);
+        dirty.push_back(1);
+        firstDirty = std::min(firstDirty, index);
+        return index;
+    }
+
+    // marks the node only if the matrix actually changed
+    void setLocal(int node, const glm::mat4& local)
+    {
+        if (memcmp(&locals[node], &local, sizeof(glm::mat4)) == 0) return;
+        locals[node] = local;
+        dirty[node] = 1;
+        firstDirty = std::min(firstDirty, node);
+    }
+
+    const glm::mat4& local(int node) const { return locals[node]; }
+    const glm::mat4& world(int node) const { return worlds[node]; }
+
+    // contiguous world matrices, index = node
+    const glm::mat4* worldData() const { return worlds.data(); }
+    unsigned int size() const { return (unsigned int)locals.size(); }
+
+    // nodes recomputed by the last update(), for the stats
+    unsigned int lastUpdated() const { return updated; }
+
+    void update()
+    {
+        updated = 0;
+        int count = (int)locals.size();
+        // parents come first, so a node sees its parent's final dirty flag for this pass
+        for (int i = firstDirty; i < count; i++) {
+            int parent = parents[i];
+            if (parent >= 0 && dirty[parent]) dirty[i] = 1;
+            if (!dirty[i]) continue;
+            worlds[i] = parent >= 0 ? worlds[parent] * locals[i] : locals[i];
+            updated++;
+        }
+        // clear only after the pass, children further down read their parent's flag
+        for (int i = firstDirty; i < count; i++) dirty[i] = 0;
+        firstDirty = count;
+    }
+
+    void clear()
+    {
+        parents.clear();
+        locals.clear();
+        worlds.clear();
+        dirty.clear();
+        firstDirty = 0;
+    }
+
+private:
+    std::vector<int> parents;
+    std::vector<glm::mat4> locals;
+    std::vector<glm::mat4> worlds;
+    std::vector<unsigned char> dirty;
+    int firstDirty = 0;
+    unsigned int updated = 0;
+};
+
+#endif